@@ -0,0 +1,202 @@
+#include "async_log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "utf8.hpp"
+
+namespace
+{
+	unsigned long const ring_size = 4 * 1024 * 1024;
+	std::size_t const write_buffer_size = 256 * 1024;
+	//The writer is woken early once this much text is waiting, otherwise it polls
+	unsigned long const wake_threshold = 64 * 1024;
+	DWORD const poll_interval = 50;
+
+	unsigned long load_position(LONG volatile & position)
+	{
+		return static_cast<unsigned long>(InterlockedCompareExchange(&position, 0, 0));
+	}
+
+	void store_position(LONG volatile & position, unsigned long value)
+	{
+		InterlockedExchange(&position, static_cast<LONG>(value));
+	}
+
+	unsigned long long load_count(LONGLONG volatile & count)
+	{
+		return static_cast<unsigned long long>(InterlockedCompareExchange64(&count, 0, 0));
+	}
+}
+
+async_log::async_log():
+	sync_interval(0),
+	ring_mask(ring_size - 1),
+	write_position(0),
+	read_position(0),
+	stopping(0),
+	file_handle(INVALID_HANDLE_VALUE),
+	thread_handle(0),
+	data_event(0),
+	queued_bytes(0),
+	dropped_bytes(0),
+	written_bytes(0),
+	failed_bytes(0)
+{
+}
+
+async_log::~async_log()
+{
+	close();
+}
+
+bool async_log::open(std::string const & new_path, unsigned new_sync_interval)
+{
+	close();
+	file_handle = CreateFileW(utf8::to_wide(new_path).c_str(), GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if(file_handle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER distance;
+	distance.QuadPart = 0;
+	SetFilePointerEx(file_handle, distance, 0, FILE_END);
+
+	path = new_path;
+	sync_interval = new_sync_interval;
+	ring.resize(ring_size);
+	write_position = 0;
+	read_position = 0;
+	stopping = 0;
+	queued_bytes = 0;
+	dropped_bytes = 0;
+	written_bytes = 0;
+	failed_bytes = 0;
+	data_event = CreateEvent(0, FALSE, FALSE, 0);
+	thread_handle = CreateThread(0, 0, &writer_entry, this, 0, 0);
+	return true;
+}
+
+void async_log::close()
+{
+	if(!is_open())
+		return;
+	//The writer drains everything that has been queued before it exits
+	InterlockedExchange(&stopping, 1);
+	SetEvent(data_event);
+	WaitForSingleObject(thread_handle, INFINITE);
+	CloseHandle(thread_handle);
+	CloseHandle(data_event);
+	CloseHandle(file_handle);
+	thread_handle = 0;
+	data_event = 0;
+	file_handle = INVALID_HANDLE_VALUE;
+	std::vector<char>().swap(ring);
+}
+
+bool async_log::is_open() const
+{
+	return file_handle != INVALID_HANDLE_VALUE;
+}
+
+void async_log::write(char const * data, std::size_t length)
+{
+	if(!is_open() || length == 0)
+		return;
+	unsigned long write = static_cast<unsigned long>(write_position);
+	unsigned long used = write - load_position(read_position);
+	unsigned long available = ring_size - used;
+	if(length > available)
+	{
+		dropped_bytes += length;
+		return;
+	}
+
+	unsigned long offset = write & ring_mask;
+	std::size_t first_part = std::min<std::size_t>(length, ring_size - offset);
+	std::memcpy(&ring[offset], data, first_part);
+	std::memcpy(&ring[0], data + first_part, length - first_part);
+	store_position(write_position, write + static_cast<unsigned long>(length));
+	queued_bytes += length;
+
+	if(used < wake_threshold && used + length >= wake_threshold)
+		SetEvent(data_event);
+}
+
+void async_log::write(std::string const & text)
+{
+	write(text.c_str(), text.length());
+}
+
+std::string const & async_log::get_path() const
+{
+	return path;
+}
+
+unsigned long long async_log::get_queued_bytes() const
+{
+	return queued_bytes;
+}
+
+unsigned long long async_log::get_written_bytes() const
+{
+	return load_count(written_bytes);
+}
+
+unsigned long long async_log::get_dropped_bytes() const
+{
+	return dropped_bytes + load_count(failed_bytes);
+}
+
+DWORD WINAPI async_log::writer_entry(LPVOID parameter)
+{
+	static_cast<async_log *>(parameter)->run_writer();
+	return 0;
+}
+
+void async_log::run_writer()
+{
+	std::vector<char> buffer(write_buffer_size);
+	DWORD last_sync = GetTickCount();
+	bool unsynced = false;
+	while(true)
+	{
+		WaitForSingleObject(data_event, poll_interval);
+		bool stop = stopping != 0;
+		if(drain(buffer))
+			unsynced = true;
+		if(unsynced && sync_interval > 0 && (stop || GetTickCount() - last_sync >= sync_interval))
+		{
+			FlushFileBuffers(file_handle);
+			last_sync = GetTickCount();
+			unsynced = false;
+		}
+		if(stop)
+			return;
+	}
+}
+
+bool async_log::drain(std::vector<char> & buffer)
+{
+	bool wrote = false;
+	while(true)
+	{
+		unsigned long read = static_cast<unsigned long>(read_position);
+		unsigned long length = std::min<unsigned long>(load_position(write_position) - read, static_cast<unsigned long>(buffer.size()));
+		if(length == 0)
+			return wrote;
+
+		unsigned long offset = read & ring_mask;
+		std::size_t first_part = std::min<std::size_t>(length, ring_size - offset);
+		std::memcpy(&buffer[0], &ring[offset], first_part);
+		std::memcpy(&buffer[0] + first_part, &ring[0], length - first_part);
+		store_position(read_position, read + length);
+
+		//Text which could not be written is lost just like text which did not fit into the ring buffer
+		DWORD written;
+		if(!WriteFile(file_handle, &buffer[0], length, &written, 0))
+			written = 0;
+		InterlockedExchangeAdd64(&written_bytes, static_cast<LONGLONG>(written));
+		if(written < length)
+			InterlockedExchangeAdd64(&failed_bytes, static_cast<LONGLONG>(length - written));
+		wrote = wrote || written > 0;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+//Appends text to a file from a writer thread. The text is passed through a lock free ring buffer with a single producer and
+//a single consumer, writing never blocks the producer and text which does not fit into the ring buffer is dropped and counted.
+class async_log
+{
+public:
+	async_log();
+	~async_log();
+
+	//Flushes the file to the disk every sync_interval milliseconds, never if it is 0
+	bool open(std::string const & path, unsigned sync_interval);
+	void close();
+	bool is_open() const;
+
+	void write(char const * data, std::size_t length);
+	void write(std::string const & text);
+
+	std::string const & get_path() const;
+	unsigned long long get_queued_bytes() const;
+	//Bytes which have reached the file, the text which is still queued is not included
+	unsigned long long get_written_bytes() const;
+	//Includes the bytes which did not fit into the ring buffer and those which the writer failed to write to the file
+	unsigned long long get_dropped_bytes() const;
+
+private:
+	std::string path;
+	unsigned sync_interval;
+
+	std::vector<char> ring;
+	unsigned long ring_mask;
+	//Positions increase monotonically and wrap around, the producer only ever modifies the write position and the writer the read position
+	LONG volatile write_position;
+	LONG volatile read_position;
+	LONG volatile stopping;
+
+	HANDLE file_handle;
+	HANDLE thread_handle;
+	HANDLE data_event;
+
+	unsigned long long queued_bytes;
+	unsigned long long dropped_bytes;
+	//Updated by the writer while the producer reads them
+	mutable LONGLONG volatile written_bytes;
+	mutable LONGLONG volatile failed_bytes;
+
+	static DWORD WINAPI writer_entry(LPVOID parameter);
+	void run_writer();
+	bool drain(std::vector<char> & buffer);
+
+	async_log(async_log const &);
+	async_log & operator=(async_log const &);
+};
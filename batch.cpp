@@ -0,0 +1,22 @@
+#include "batch.hpp"
+
+#include <fstream>
+
+#include "console.hpp"
+
+int run_batch(std::vector<std::string> const & arguments)
+{
+	if(arguments.size() < 3)
+		return 1;
+	//The console never touches the resources since it has no window to draw to
+	render_resources resources;
+	directory_cache listings;
+	console batch_console(resources, listings);
+	//The output is opened first since cd in the script changes the current directory of the process
+	std::ofstream output_stream(arguments[2].c_str(), std::ios::out | std::ios::binary);
+	if(!output_stream || !batch_console.run_script(arguments[1]))
+		return 1;
+	while(batch_console.idle());
+	output_stream << batch_console.get_history();
+	return output_stream ? 0 : 1;
+}
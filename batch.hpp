@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//caqypowu --run <script> <output>
+//Runs a script without a window and writes the transcript of the session to the output file
+int run_batch(std::vector<std::string> const & arguments);
@@ -0,0 +1,409 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+
+#include "timing.hpp"
+#include "vt_parser.hpp"
+#include "find.hpp"
+#include "glob.hpp"
+#include "grep.hpp"
+#include "mapped_file.hpp"
+#include "async_log.hpp"
+#include "directory.hpp"
+#include "utf8.hpp"
+
+namespace
+{
+	std::size_t const chunk_size = 4096;
+	std::size_t const minimum_volume = 64 * 1024 * 1024;
+
+	bool read_file(std::string const & path, std::string & output)
+	{
+		std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+		if(!stream)
+			return false;
+		output.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	double get_throughput(std::size_t bytes, unsigned long long microseconds)
+	{
+		if(microseconds == 0)
+			microseconds = 1;
+		return static_cast<double>(bytes) / static_cast<double>(microseconds);
+	}
+
+	//vt <input>: parses captured terminal output in pipe sized chunks, as it would arrive from a running tool
+	bool benchmark_vt_parser(std::vector<std::string> const & arguments, std::ostringstream & report)
+	{
+		if(arguments.empty())
+			return false;
+		std::string input;
+		if(!read_file(arguments[0], input) || input.empty())
+			return false;
+
+		std::size_t repetitions = minimum_volume / input.length() + 1;
+		std::size_t volume = repetitions * input.length();
+
+		std::string text;
+		text.reserve(volume);
+		unsigned long long copy_start = get_microseconds();
+		for(std::size_t i = 0; i < repetitions; i++)
+		{
+			for(std::size_t offset = 0; offset < input.length(); offset += chunk_size)
+				text.append(input, offset, chunk_size);
+		}
+		unsigned long long copy_duration = get_microseconds() - copy_start;
+
+		text.clear();
+		std::vector<attribute_span> spans;
+		vt_parser parser;
+		unsigned long long parse_start = get_microseconds();
+		for(std::size_t i = 0; i < repetitions; i++)
+		{
+			for(std::size_t offset = 0; offset < input.length(); offset += chunk_size)
+				parser.process(input.c_str() + offset, std::min(chunk_size, input.length() - offset), text, spans);
+		}
+		unsigned long long parse_duration = get_microseconds() - parse_start;
+
+		report << std::fixed << std::setprecision(1);
+		report << "Input: " << arguments[0] << " (" << input.length() << " bytes, repeated " << repetitions << " times)\n";
+		report << "Text: " << text.length() << " bytes, " << spans.size() << " attribute spans\n";
+		report << "Plain copy: " << get_throughput(volume, copy_duration) << " MB/s\n";
+		report << "VT parser: " << get_throughput(volume, parse_duration) << " MB/s\n";
+		return true;
+	}
+
+	//Creates directories of 1000 files each, grouped into directories of 100 directories
+	bool create_synthetic_tree(std::string const & root, unsigned long file_count)
+	{
+		std::size_t const files_per_directory = 1000;
+		std::size_t const directories_per_group = 100;
+		CreateDirectoryW(utf8::to_wide(root).c_str(), 0);
+		std::size_t directory_count = (file_count + files_per_directory - 1) / files_per_directory;
+		for(std::size_t directory = 0; directory < directory_count; directory++)
+		{
+			std::ostringstream group_stream;
+			group_stream << root << "\\group" << directory / directories_per_group;
+			std::string group = group_stream.str();
+			if(directory % directories_per_group == 0)
+				CreateDirectoryW(utf8::to_wide(group).c_str(), 0);
+
+			std::ostringstream directory_stream;
+			directory_stream << group << "\\directory" << directory;
+			std::string directory_path = directory_stream.str();
+			if(!CreateDirectoryW(utf8::to_wide(directory_path).c_str(), 0))
+				return false;
+
+			for(std::size_t file = 0; file < files_per_directory && directory * files_per_directory + file < file_count; file++)
+			{
+				std::ostringstream file_stream;
+				file_stream << directory_path << "\\file" << file << (file % 10 == 0 ? ".log" : ".txt");
+				HANDLE file_handle = CreateFileW(utf8::to_wide(file_stream.str()).c_str(), GENERIC_WRITE, 0, 0, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+				if(file_handle == INVALID_HANDLE_VALUE)
+					return false;
+				CloseHandle(file_handle);
+			}
+		}
+		return true;
+	}
+
+	//find <root> [<pattern>] [<file count>]: walks the tree with 1, 2, 4... workers up to the number of processors,
+	//the synthetic tree is created first if a file count is given and the root does not exist yet
+	bool benchmark_find(std::vector<std::string> const & arguments, std::ostringstream & report)
+	{
+		if(arguments.empty())
+			return false;
+		find_options options;
+		options.root = arguments[0];
+		if(arguments.size() > 1)
+			options.pattern = arguments[1];
+		glob_pattern pattern;
+		std::string error;
+		if(!pattern.compile(options.pattern, error))
+			return false;
+		if(arguments.size() > 2 && GetFileAttributesW(utf8::to_wide(options.root).c_str()) == INVALID_FILE_ATTRIBUTES)
+		{
+			unsigned long file_count = std::strtoul(arguments[2].c_str(), 0, 10);
+			unsigned long long creation_start = get_microseconds();
+			if(!create_synthetic_tree(options.root, file_count))
+				return false;
+			report << "Created " << file_count << " files in " << (get_microseconds() - creation_start) / 1000 << " ms\n";
+		}
+
+		std::vector<unsigned> worker_counts;
+		unsigned processor_count = thread_pool::get_processor_count();
+		for(unsigned workers = 1; workers < processor_count; workers *= 2)
+			worker_counts.push_back(workers);
+		worker_counts.push_back(processor_count);
+
+		report << std::fixed << std::setprecision(2);
+		report << "Root: " << options.root << ", pattern: " << options.pattern << "\n\n";
+		report << std::setw(8) << "workers" << std::setw(12) << "entries" << std::setw(12) << "matches" << std::setw(12) << "ms" << std::setw(16) << "entries/s" << std::setw(10) << "speedup" << "\n";
+		unsigned long long single_duration = 0;
+		std::vector<std::string> paths;
+		for(std::vector<unsigned>::const_iterator i = worker_counts.begin(), end = worker_counts.end(); i != end; i++)
+		{
+			unsigned long long start = get_microseconds();
+			parallel_find find(options, *i);
+			std::size_t match_count = 0;
+			while(true)
+			{
+				bool finished = find.is_finished();
+				paths.clear();
+				find.take_results(paths, 4096, 1);
+				match_count += paths.size();
+				if(finished && paths.size() < 4096)
+					break;
+			}
+			unsigned long long duration = std::max(get_microseconds() - start, 1ull);
+			if(single_duration == 0)
+				single_duration = duration;
+			report << std::setw(8) << *i << std::setw(12) << find.get_entry_count() << std::setw(12) << match_count;
+			report << std::setw(12) << duration / 1000.0 << std::setw(16) << find.get_entry_count() * 1000000.0 / duration;
+			report << std::setw(10) << static_cast<double>(single_duration) / duration << "\n";
+		}
+		return true;
+	}
+
+	//grep <pattern> <files...>: compares the search with a plain pass over the same mapped and cached files
+	bool benchmark_grep(std::vector<std::string> const & arguments, std::ostringstream & report)
+	{
+		if(arguments.size() < 2)
+			return false;
+		grep_pattern pattern;
+		std::string error;
+		if(!pattern.compile(arguments[0], error))
+			return false;
+		std::vector<std::string> paths(arguments.begin() + 1, arguments.end());
+
+		//The first pass also brings the files into the cache
+		std::size_t total_size = 0;
+		unsigned checksum = 0;
+		unsigned long long read_duration = 0;
+		for(int pass = 0; pass < 2; pass++)
+		{
+			unsigned long long read_start = get_microseconds();
+			total_size = 0;
+			for(std::vector<std::string>::const_iterator i = paths.begin(), end = paths.end(); i != end; i++)
+			{
+				mapped_file file;
+				if(!file.open(*i))
+					return false;
+				char const * data = file.get_data();
+				for(std::size_t offset = 0; offset < file.get_size(); offset += 64)
+					checksum += static_cast<unsigned char>(data[offset]);
+				total_size += file.get_size();
+			}
+			read_duration = get_microseconds() - read_start;
+		}
+
+		//Lines without the literal are never passed to the expression, so a match which lacks it would be lost
+		std::string const & literal = pattern.get_literal();
+		std::size_t checked_matches = 0;
+		std::size_t literal_misses = 0;
+		for(std::vector<std::string>::const_iterator i = paths.begin(), end = paths.end(); i != end; i++)
+		{
+			mapped_file file;
+			if(!file.open(*i))
+				return false;
+			char const * data = file.get_data();
+			char const * data_end = data + file.get_size();
+			for(char const * line = data; line < data_end;)
+			{
+				char const * line_end = std::find(line, data_end, '\n');
+				std::size_t offset;
+				std::size_t length;
+				if(pattern.find_match(line, line_end, offset, length))
+				{
+					checked_matches++;
+					if(std::search(line + offset, line + offset + length, literal.begin(), literal.end()) == line + offset + length && !literal.empty())
+						literal_misses++;
+				}
+				line = line_end + 1;
+			}
+		}
+
+		unsigned processor_count = thread_pool::get_processor_count();
+		report << std::fixed << std::setprecision(1);
+		report << "Pattern: " << arguments[0] << ", literal prefilter: \"" << pattern.get_literal() << "\"\n";
+		report << "Literal check: " << literal_misses << " of " << checked_matches << " matches do not contain the literal\n";
+		if(literal_misses != 0)
+			return false;
+		report << "Files: " << paths.size() << ", " << total_size << " bytes (checksum " << checksum << ")\n";
+		report << "Touching every cache line: " << get_throughput(total_size, read_duration) << " MB/s\n";
+		std::vector<std::string> lines;
+		for(unsigned workers = 1;; workers = std::min(workers * 2, processor_count))
+		{
+			unsigned long long search_start = get_microseconds();
+			std::size_t match_count = 0;
+			{
+				parallel_grep search(pattern, paths, workers);
+				bool more = true;
+				while(more)
+				{
+					lines.clear();
+					more = search.take_results(lines, 4096, 1);
+					match_count += lines.size();
+				}
+			}
+			unsigned long long search_duration = get_microseconds() - search_start;
+			report << "grep with " << workers << " workers: " << get_throughput(total_size, search_duration) << " MB/s, " << match_count << " matching lines\n";
+			if(workers == processor_count)
+				break;
+		}
+		return true;
+	}
+
+	//listing <entry count>: memory of a synthetic listing compared to the names in separate strings, and the time to sort it
+	//by each order with 1, 2, 4... workers up to the number of processors
+	bool benchmark_listing(std::vector<std::string> const & arguments, std::ostringstream & report)
+	{
+		if(arguments.empty())
+			return false;
+		unsigned long entry_count = std::strtoul(arguments[0].c_str(), 0, 10);
+		if(entry_count == 0)
+			return false;
+
+		//The names, sizes and times are scattered so that no order is already sorted
+		directory_listing listing;
+		std::size_t name_bytes = 0;
+		unsigned long long state = 1;
+		for(unsigned long i = 0; i < entry_count; i++)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			std::ostringstream name;
+			name << "Entry " << (state >> 40) << (i % 8 == 0 ? ".log" : ".txt");
+			WIN32_FIND_DATAW find_data = WIN32_FIND_DATAW();
+			find_data.dwFileAttributes = i % 16 == 0 ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+			find_data.nFileSizeLow = static_cast<DWORD>(state >> 20);
+			find_data.ftLastWriteTime.dwHighDateTime = static_cast<DWORD>(state >> 48) | 0x01d00000;
+			find_data.ftLastWriteTime.dwLowDateTime = static_cast<DWORD>(state >> 8);
+			listing.add(name.str(), find_data);
+			name_bytes += name.str().length();
+		}
+		listing.compact();
+
+		std::vector<unsigned> worker_counts;
+		unsigned processor_count = thread_pool::get_processor_count();
+		for(unsigned workers = 1; workers < processor_count; workers *= 2)
+			worker_counts.push_back(workers);
+		worker_counts.push_back(processor_count);
+
+		//Every string of a vector takes its own object and, once it is too long to be stored inline, an allocation for the name
+		std::size_t listing_bytes = listing.get_memory_usage();
+		std::size_t strings_bytes = entry_count * sizeof(std::string) + name_bytes;
+		report << std::fixed << std::setprecision(2);
+		report << "Entries: " << entry_count << ", " << name_bytes << " bytes of names\n";
+		std::size_t name_column_bytes = name_bytes + entry_count * sizeof(unsigned);
+		report << "Columnar listing: " << listing_bytes << " bytes (" << static_cast<double>(listing_bytes) / entry_count << " per entry), ";
+		report << name_column_bytes << " bytes of them for the names (" << static_cast<double>(name_column_bytes) / entry_count << " per entry)\n";
+		report << "Names alone in a vector of strings: at least " << strings_bytes << " bytes (" << static_cast<double>(strings_bytes) / entry_count << " per entry)\n\n";
+
+		char const * order_names[] = {"name", "size", "time"};
+		report << std::setw(8) << "order" << std::setw(10) << "workers" << std::setw(12) << "ms" << std::setw(10) << "speedup" << "\n";
+		for(int order = listing_order_name; order <= listing_order_time; order++)
+		{
+			unsigned long long single_duration = 0;
+			for(std::vector<unsigned>::const_iterator i = worker_counts.begin(), end = worker_counts.end(); i != end; i++)
+			{
+				directory_listing unsorted = listing;
+				unsigned long long start = get_microseconds();
+				unsorted.sort(static_cast<listing_order>(order), *i);
+				unsigned long long duration = std::max(get_microseconds() - start, 1ull);
+				if(single_duration == 0)
+					single_duration = duration;
+				report << std::setw(8) << order_names[order] << std::setw(10) << *i << std::setw(12) << duration / 1000.0;
+				report << std::setw(10) << static_cast<double>(single_duration) / duration << "\n";
+			}
+		}
+		return true;
+	}
+
+	//log <input> <log file>: parses captured output as in the vt benchmark, once on its own and once teed into the session log
+	bool benchmark_log(std::vector<std::string> const & arguments, std::ostringstream & report)
+	{
+		if(arguments.size() < 2)
+			return false;
+		std::string input;
+		if(!read_file(arguments[0], input) || input.empty())
+			return false;
+		std::size_t repetitions = minimum_volume / input.length() + 1;
+		std::size_t volume = repetitions * input.length();
+
+		unsigned long long durations[2];
+		unsigned long long close_duration = 0;
+		unsigned long long dropped_bytes = 0;
+		for(int logging = 0; logging < 2; logging++)
+		{
+			async_log log;
+			if(logging && !log.open(arguments[1], 0))
+				return false;
+			std::string text;
+			std::vector<attribute_span> spans;
+			vt_parser parser;
+			unsigned long long start = get_microseconds();
+			for(std::size_t i = 0; i < repetitions; i++)
+			{
+				for(std::size_t offset = 0; offset < input.length(); offset += chunk_size)
+				{
+					std::size_t length = std::min(chunk_size, input.length() - offset);
+					if(logging)
+						log.write(input.c_str() + offset, length);
+					parser.process(input.c_str() + offset, length, text, spans);
+				}
+			}
+			durations[logging] = get_microseconds() - start;
+			if(logging)
+			{
+				dropped_bytes = log.get_dropped_bytes();
+				unsigned long long close_start = get_microseconds();
+				log.close();
+				close_duration = get_microseconds() - close_start;
+			}
+		}
+
+		report << std::fixed << std::setprecision(1);
+		report << "Input: " << arguments[0] << " (" << volume << " bytes in " << chunk_size << " byte chunks)\n";
+		report << "Without log: " << get_throughput(volume, durations[0]) << " MB/s\n";
+		report << "With log: " << get_throughput(volume, durations[1]) << " MB/s\n";
+		report << "Dropped: " << dropped_bytes << " bytes\n";
+		report << "Draining the log on close: " << close_duration / 1000 << " ms\n";
+		return true;
+	}
+}
+
+int run_benchmark(std::vector<std::string> const & arguments)
+{
+	if(arguments.size() < 3)
+		return 1;
+	std::string const & name = arguments[1];
+	std::string const & report_path = arguments[2];
+	std::vector<std::string> benchmark_arguments(arguments.begin() + 3, arguments.end());
+
+	std::ostringstream report;
+	bool success;
+	if(name == "vt")
+		success = benchmark_vt_parser(benchmark_arguments, report);
+	else if(name == "find")
+		success = benchmark_find(benchmark_arguments, report);
+	else if(name == "grep")
+		success = benchmark_grep(benchmark_arguments, report);
+	else if(name == "log")
+		success = benchmark_log(benchmark_arguments, report);
+	else if(name == "listing")
+		success = benchmark_listing(benchmark_arguments, report);
+	else
+		success = false;
+	//A benchmark which fails a check has still reported what it found
+	if(report.str().empty())
+		return 1;
+
+	std::ofstream report_stream(report_path.c_str());
+	report_stream << report.str();
+	return success && report_stream ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//caqypowu --benchmark <name> <report> <arguments...>
+//caqypowu --benchmark vt <report> <input>
+//caqypowu --benchmark find <report> <root> [<pattern>] [<file count>]
+//caqypowu --benchmark grep <report> <pattern> <files...>
+//caqypowu --benchmark log <report> <input> <log file>
+//caqypowu --benchmark listing <report> <entry count>
+int run_benchmark(std::vector<std::string> const & arguments);
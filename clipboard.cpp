@@ -0,0 +1,50 @@
+#include "clipboard.hpp"
+
+#include <cstring>
+
+#include <windows.h>
+
+#include "utf8.hpp"
+
+bool set_clipboard_text(std::string const & text)
+{
+	std::wstring wide_text = utf8::to_wide(text);
+	std::size_t size = (wide_text.length() + 1) * sizeof(wchar_t);
+	HGLOBAL memory = GlobalAlloc(GMEM_MOVEABLE, size);
+	if(memory == 0)
+		return false;
+	std::memcpy(GlobalLock(memory), wide_text.c_str(), size);
+	GlobalUnlock(memory);
+
+	if(!OpenClipboard(0))
+	{
+		GlobalFree(memory);
+		return false;
+	}
+	EmptyClipboard();
+	bool success = SetClipboardData(CF_UNICODETEXT, memory) != 0;
+	CloseClipboard();
+	if(!success)
+		GlobalFree(memory);
+	return success;
+}
+
+bool get_clipboard_text(std::string & text)
+{
+	if(!IsClipboardFormatAvailable(CF_UNICODETEXT) || !OpenClipboard(0))
+		return false;
+	bool success = false;
+	HANDLE memory = GetClipboardData(CF_UNICODETEXT);
+	if(memory != 0)
+	{
+		wchar_t const * wide_text = static_cast<wchar_t const *>(GlobalLock(memory));
+		if(wide_text != 0)
+		{
+			text = utf8::from_wide(wide_text);
+			GlobalUnlock(memory);
+			success = true;
+		}
+	}
+	CloseClipboard();
+	return success;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+//Clipboard access using UTF-8 strings, the text is exchanged as CF_UNICODETEXT
+bool set_clipboard_text(std::string const & text);
+bool get_clipboard_text(std::string & text);
@@ -3,25 +3,98 @@
 #include <algorithm>
 
 #include <cmath>
+#include <cstring>
+#include <sstream>
 
 #include <nil/string.hpp>
-#include <nil/clipboard.hpp>
 #include <nil/array.hpp>
 
-console::console():
+#include "utf8.hpp"
+#include "clipboard.hpp"
+#include "timing.hpp"
+#include "startup_trace.hpp"
+#include "mapped_file.hpp"
+#include "glob.hpp"
+
+namespace
+{
+	unsigned const reflow_timer = 1;
+	std::size_t const reflow_batch_size = 4096;
+	unsigned long long const reflow_time_slice = 8000;
+
+	unsigned const pipeline_timer = 2;
+	unsigned long long const pipeline_time_slice = 8000;
+
+	unsigned const commands_timer = 3;
+	unsigned long long const commands_time_slice = 16000;
+	//Scripts which run themselves, directly or through other scripts, are stopped at this depth
+	unsigned const script_depth_maximum = 8;
+
+	//Sessions share the window, so each one adds its own base to the identifiers of its timers
+	unsigned const timer_count = 3;
+	unsigned next_timer_base = 0;
+
+	//Ctrl+V
+	unsigned const paste_key = 0x16;
+
+	//C0 and C1 control characters would reach the VT parser once the command is echoed
+	bool is_control_character(unsigned code_point)
+	{
+		return code_point < ' ' || (code_point >= 0x7f && code_point < 0xa0);
+	}
+
+	//Pasted text is held to the same rules as typed text, only newlines are kept to split it into commands and tabs become spaces
+	std::string filter_pasted_text(std::string const & text)
+	{
+		std::string output;
+		output.reserve(text.length());
+		for(std::size_t offset = 0; offset < text.length();)
+		{
+			char byte = text[offset];
+			if(static_cast<unsigned char>(byte) < 0x80)
+			{
+				if(byte == '\t')
+					output += ' ';
+				else if(byte == '\n' || !is_control_character(static_cast<unsigned char>(byte)))
+					output += byte;
+				offset++;
+				continue;
+			}
+			unsigned code_point = utf8::decode(text.c_str(), text.length(), offset);
+			if(!is_control_character(code_point))
+				utf8::encode(code_point, output);
+		}
+		return output;
+	}
+}
+
+console::console(render_resources & resources, directory_cache & listings):
+	resources(resources),
+	listings(listings),
+
 	initialised(false),
-	font(0),
+	active(true),
+	window_handle(0),
+	timer_base(next_timer_base),
+	width(0),
+	height(0),
 
 	border(2),
 
-	background_colour(RGB(0, 0, 0)),
-	text_colour(RGB(255, 255, 255)),
+	background_colour(resources.get_background_colour()),
+	text_colour(resources.get_text_colour()),
+
+	buffer_dc(0),
+	font_width(resources.get_font_width()),
+	font_height(resources.get_font_height()),
 
 	scrollbar_width(16),
 	scroll_line_offset(0),
 	original_scroll_line_offset(0),
 
 	selection(false),
+	selection_offset_begin(0),
+	selection_offset_end(0),
 	scrollbar_click(false),
 
 	allow_input(true),
@@ -29,13 +102,28 @@ console::console():
 
 	command_input_prefix("> "),
 
-	tabbing(false)
-{
-	create_font("Lucida Console", 8, 12);
+	tabbing(false),
 
-	background_brush = CreateSolidBrush(background_colour);
-	foreground_pen = CreatePen(PS_SOLID, 1, text_colour);
+	high_surrogate(0),
 
+	tail_offset(0),
+	tail_rows(0),
+	anchored(false),
+	reflow_scheduled(false),
+
+	running_pipeline(0),
+	pipeline_scheduled(false),
+
+	command_depth(0),
+	commands_scheduled(false),
+	layout_suspended(false),
+
+	paste_start(0),
+	paste_duration(0),
+	paste_bytes(0),
+	paste_lines(0)
+{
+	next_timer_base += timer_count;
 	set_working_directory();
 
 	command_input();
@@ -43,11 +131,12 @@ console::console():
 
 console::~console()
 {
-	free_bitmap_and_dc();
-
-	DeleteObject(font);
-	DeleteObject(background_brush);
-	DeleteObject(foreground_pen);
+	deactivate();
+	if(pipeline_scheduled)
+		kill_timer(pipeline_timer);
+	if(commands_scheduled)
+		kill_timer(commands_timer);
+	delete running_pipeline;
 }
 
 void console::initialise(HWND new_window_handle)
@@ -64,15 +153,24 @@ void console::input(unsigned key)
 	{
 		if(key == VK_TAB)
 			process_tab();
+		else if(key == paste_key)
+		{
+			paste();
+			return;
+		}
 		else
 		{
 			tabbing = false;
 
-			char input = static_cast<char>(key);
-			if(input < ' ' || input > '~')
+			unsigned code_point;
+			if(!decode_character_input(key, code_point))
 				return;
-			command.insert(command_input_offset, 1, input);
-			command_input_offset++;
+			if(is_control_character(code_point))
+				return;
+			std::string character;
+			utf8::encode(code_point, character);
+			command.insert(command_input_offset, character);
+			command_input_offset += character.length();
 		}
 		update();
 	}
@@ -103,27 +201,37 @@ void console::key_down(unsigned key)
 	case VK_ESCAPE:
 		if(allow_input)
 			clear_command();
+		else
+		{
+			pending_commands.clear();
+			layout_suspended = false;
+			if(running_pipeline != 0)
+			{
+				print("Cancelled\n");
+				finish_pipeline();
+			}
+		}
 		break;
 
 	case VK_LEFT:
-		if(command_input_offset > 0)
-			command_input_offset--;
+		command_input_offset = utf8::previous_character(command, command_input_offset);
 		break;
 
 	case VK_RIGHT:
-		command_input_offset = std::min(command_input_offset + 1, command.length());
+		command_input_offset = utf8::next_character(command, command_input_offset);
 		break;
 
 	case VK_DELETE:
 		if(!command.empty() && command_input_offset != command.length())
-			command.erase(command.begin() + command_input_offset);
+			command.erase(command_input_offset, utf8::next_character(command, command_input_offset) - command_input_offset);
 		break;
 
 	case VK_BACK:
 		if(!command.empty() && command_input_offset > 0)
 		{
-			command_input_offset--;
-			command.erase(command.begin() + command_input_offset);
+			std::size_t previous_offset = utf8::previous_character(command, command_input_offset);
+			command.erase(previous_offset, command_input_offset - previous_offset);
+			command_input_offset = previous_offset;
 		}
 		break;
 
@@ -170,7 +278,7 @@ void console::left_mouse_button_up(unsigned x, unsigned y)
 	if(selection)
 	{
 		selection = false;
-		nil::set_clipboard(content.substr(selection_offset_begin, selection_offset_end - selection_offset_begin));
+		set_clipboard_text(get_content(selection_offset_begin, selection_offset_end));
 	}
 	else if(scrollbar_click)
 	{
@@ -183,33 +291,26 @@ void console::left_mouse_button_up(unsigned x, unsigned y)
 
 void console::right_mouse_button_down(unsigned x, unsigned y)
 {
-	//This sucks because we are going to use the RMB for setting the cursor instead
-	/*
-	if(allow_input)
+	//The RMB sets the cursor, pasting is done with Ctrl+V
+	if(allow_input && scroll_line_offset == 0)
 	{
-		std::string clipboard = nil::get_clipboard();
-		std::size_t newline_offset = clipboard.find('\n');
-		if(newline_offset != std::string::npos)
-			clipboard.erase(clipboard.begin() + newline_offset, clipboard.end());
-		command += clipboard;
-	}
-	*/
-	if(allow_input)
-	{
-		unsigned command_lines_length = static_cast<unsigned>(command.length() + command_input_prefix.length());
-		unsigned quotient = command_lines_length / letters_per_line_maximum;
-		unsigned remainder = command_lines_length % letters_per_line_maximum;
-		unsigned command_lines = quotient;
-		if(remainder)
-			command_lines++;
-		if(x > border && x < width - scrollbar_width - 2 * border && y > height - border - command_lines * font_height && y < height - border)
+		//The command is part of the last line of the content, which occupies the bottom rows when the view is not scrolled
+		std::size_t line_offset = tail_offset;
+		std::string const & line = content_tail;
+		get_row_offsets(line, row_offsets);
+		//Only the rows which fit into the window can be clicked, the distance from the bottom is taken first so that nothing wraps
+		//when the line has more rows than the window
+		unsigned command_lines = std::min(static_cast<unsigned>(row_offsets.size()), lines_maximum);
+		if(x > border && x < width - scrollbar_width - 2 * border && y < height - border && (height - border - y) / font_height < command_lines)
 		{
-			unsigned offset_x = (x - border) / font_width;
-			unsigned offset_y = (y - border - (lines_maximum - command_lines) * font_height) / font_height;
-			int offset = offset_x + offset_y * letters_per_line_maximum;
-			offset = std::max(offset - static_cast<int>(command_input_prefix.length()), 0);
-			offset = std::min(offset, static_cast<int>(command.length()));
-			command_input_offset = static_cast<std::size_t>(offset);
+			unsigned columns = (x - border) / font_width;
+			std::size_t row = row_offsets.size() - 1 - (height - border - y) / font_height;
+			std::size_t row_begin = row_offsets[row];
+			std::size_t row_end = row + 1 < row_offsets.size() ? row_offsets[row + 1] : line.length();
+			std::size_t offset = line_offset + row_begin + utf8::fit_columns(line.c_str() + row_begin, row_end - row_begin, columns);
+			offset = std::max(offset, history.length());
+			offset = std::min(offset, history.length() + command.length());
+			command_input_offset = offset - history.length();
 			update();
 		}
 	}
@@ -240,32 +341,32 @@ void console::mouse_wheel(int direction)
 		scroll_down();
 }
 
-void console::create_dc(HDC window_dc)
+void console::set_size(unsigned new_width, unsigned new_height)
 {
-	RECT client_rectangle;
-	GetClientRect(window_handle, &client_rectangle);
-	width = static_cast<unsigned>(client_rectangle.right);
-	height = static_cast<unsigned>(client_rectangle.bottom);
-
-	buffer_dc = CreateCompatibleDC(window_dc);
-	bitmap = CreateCompatibleBitmap(window_dc, width, height);
-
-	SelectObject(buffer_dc, bitmap);
-	SelectObject(buffer_dc, font);
-	SelectObject(buffer_dc, foreground_pen);
-
-	initialised = true;
+	width = new_width;
+	height = new_height;
 }
 
 void console::draw()
 {
+	//Without a window there is nothing to paint to, only the layout is performed
+	if(window_handle == 0)
+	{
+		process_content();
+		return;
+	}
+
 	PAINTSTRUCT paint_object;
 	HDC window_dc = BeginPaint(window_handle, &paint_object);
 	if(!initialised)
 	{
-		create_dc(window_dc);
+		RECT client_rectangle;
+		GetClientRect(window_handle, &client_rectangle);
+		set_size(static_cast<unsigned>(client_rectangle.right), static_cast<unsigned>(client_rectangle.bottom));
+		initialised = true;
 		process_content();
 	}
+	buffer_dc = resources.get_buffer_dc(window_dc, width, height);
 
 	draw_background();
 	if(width >= 3 * border + font_width + scrollbar_width && height >= 6 * border + font_height + 2 * scrollbar_width)
@@ -276,66 +377,220 @@ void console::draw()
 
 	BitBlt(window_dc, 0, 0, width, height, buffer_dc, 0, 0, SRCCOPY);
 
+	//A paste is on the screen once the last of its commands has finished
+	if(paste_start != 0 && pending_commands.empty() && running_pipeline == 0)
+	{
+		paste_duration = get_microseconds() - paste_start;
+		paste_start = 0;
+	}
+
 	EndPaint(window_handle, &paint_object);
 }
 
 void console::resize()
 {
-	free_bitmap_and_dc();
-	initialised = false;
-	draw();
+	if(window_handle != 0)
+	{
+		RECT client_rectangle;
+		GetClientRect(window_handle, &client_rectangle);
+		set_size(static_cast<unsigned>(client_rectangle.right), static_cast<unsigned>(client_rectangle.bottom));
+		initialised = true;
+	}
+	update();
+}
+
+void console::activate()
+{
+	active = true;
+	//The working directory of the process follows the session in the foreground
+	if(!working_directory.empty())
+		SetCurrentDirectoryW(utf8::to_wide(working_directory).c_str());
+	resize();
+}
+
+void console::deactivate()
+{
+	active = false;
+	selection = false;
+	scrollbar_click = false;
+	//Pipelines and queued commands keep running in the background, only the layout waits for the session to be activated again
+	if(reflow_scheduled)
+	{
+		kill_timer(reflow_timer);
+		reflow_scheduled = false;
+	}
+}
+
+std::string const & console::get_working_directory() const
+{
+	return working_directory;
 }
 
-void console::create_font(std::string const & name, unsigned width, unsigned height)
+std::string const & console::get_history() const
 {
-	font_width = width;
-	font_height = height;
-	font = CreateFont(height, width, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_MODERN, name.c_str());
+	return history;
 }
 
-void console::free_bitmap_and_dc()
+console::queued_command::queued_command(std::string const & line, unsigned depth):
+	line(line),
+	depth(depth)
 {
-	if(initialised)
+}
+
+bool console::run_script(std::string const & path)
+{
+	mapped_file script;
+	if(!script.open(resolve_path(path, working_directory)))
+		return false;
+
+	//Scripts run from other scripts or from a paste are executed in place of the command which started them
+	std::deque<queued_command> script_commands;
+	char const * data = script.get_data();
+	std::size_t size = script.get_size();
+	for(std::size_t offset = 0; offset < size;)
 	{
-		DeleteObject(bitmap);
-		DeleteDC(buffer_dc);
+		char const * newline = static_cast<char const *>(std::memchr(data + offset, '\n', size - offset));
+		std::size_t end = newline == 0 ? size : static_cast<std::size_t>(newline - data);
+		std::size_t line_end = end > offset && data[end - 1] == '\r' ? end - 1 : end;
+		std::string line = nil::string::trim(std::string(data + offset, line_end - offset));
+		if(!line.empty())
+			script_commands.push_back(queued_command(line, command_depth + 1));
+		offset = end + 1;
 	}
+
+	pending_commands.insert(pending_commands.begin(), script_commands.begin(), script_commands.end());
+	if(!pending_commands.empty())
+		layout_suspended = true;
+	return true;
 }
 
 void console::update()
 {
+	//Nothing can be laid out before the size of the window is known
+	if(!active || layout_suspended || width == 0 || height == 0)
+		return;
 	process_content();
 	invalidate();
 }
 
 void console::invalidate()
 {
-	InvalidateRect(window_handle, 0, TRUE);
+	if(window_handle != 0)
+		InvalidateRect(window_handle, 0, TRUE);
 }
 
 void console::draw_text(std::string const & text, unsigned x, unsigned y)
 {
-	TextOut(buffer_dc, static_cast<int>(x), static_cast<int>(y), text.c_str(), static_cast<int>(text.length()));
+	if(utf8::is_ascii(text))
+	{
+		TextOut(buffer_dc, static_cast<int>(x), static_cast<int>(y), text.c_str(), static_cast<int>(text.length()));
+		return;
+	}
+
+	//Every character is placed on the column grid explicitly so that wide and combining characters line up with the layout
+	std::wstring wide_text;
+	std::vector<INT> advances;
+	char const * data = text.c_str();
+	std::size_t length = text.length();
+	for(std::size_t offset = 0; offset < length;)
+	{
+		unsigned code_point = utf8::decode(data, length, offset);
+		INT advance = static_cast<INT>(utf8::get_character_width(code_point) * font_width);
+		if(code_point >= 0x10000)
+		{
+			code_point -= 0x10000;
+			wide_text.push_back(static_cast<wchar_t>(0xd800 | (code_point >> 10)));
+			wide_text.push_back(static_cast<wchar_t>(0xdc00 | (code_point & 0x3ff)));
+			advances.push_back(advance);
+			advances.push_back(0);
+		}
+		else
+		{
+			wide_text.push_back(static_cast<wchar_t>(code_point));
+			advances.push_back(advance);
+		}
+	}
+	if(!wide_text.empty())
+		ExtTextOutW(buffer_dc, static_cast<int>(x), static_cast<int>(y), 0, 0, wide_text.c_str(), static_cast<UINT>(wide_text.length()), &advances[0]);
 }
 
 void console::draw_partial_line(std::string const & text, unsigned & x, unsigned y)
 {
 	draw_text(text, x, y);
-	x += static_cast<unsigned>(text.length()) * font_width;
+	x += utf8::get_width(text) * font_width;
+}
+
+void console::draw_attributed_text(std::string const & text, std::size_t content_offset, unsigned x, unsigned y)
+{
+	std::size_t length = text.length();
+	for(std::size_t offset = 0; offset < length;)
+	{
+		std::size_t position = content_offset + offset;
+		std::size_t span_end = length;
+		text_attribute attribute;
+		//The command line following the history always uses the default attribute
+		if(position < history.length())
+		{
+			std::vector<attribute_span>::const_iterator span = find_attribute_span(history_attributes, position);
+			std::vector<attribute_span>::const_iterator next_span;
+			if(span == history_attributes.end())
+				next_span = history_attributes.begin();
+			else
+			{
+				attribute = span->attribute;
+				next_span = span + 1;
+			}
+			std::size_t boundary = next_span == history_attributes.end() ? history.length() : next_span->offset;
+			span_end = std::min(span_end, boundary - content_offset);
+		}
+
+		std::string part = text.substr(offset, span_end - offset);
+		unsigned part_width = utf8::get_width(part) * font_width;
+		COLORREF foreground = set_attribute_colour(attribute);
+		draw_text(part, x, y);
+		if(attribute.flags & text_flag_bold)
+		{
+			SetBkMode(buffer_dc, TRANSPARENT);
+			draw_text(part, x + 1, y);
+			SetBkMode(buffer_dc, OPAQUE);
+		}
+		if(attribute.flags & text_flag_underline)
+		{
+			POINT line_points[2];
+			line_points[0].x = x;
+			line_points[0].y = y + font_height - 1;
+			line_points[1].x = x + part_width;
+			line_points[1].y = line_points[0].y;
+			SelectObject(buffer_dc, GetStockObject(DC_PEN));
+			SetDCPenColor(buffer_dc, foreground);
+			Polyline(buffer_dc, line_points, static_cast<int>(nil::countof(line_points)));
+			SelectObject(buffer_dc, resources.get_foreground_pen());
+		}
+
+		x += part_width;
+		offset = span_end;
+	}
+	set_text_colour(false);
+}
+
+void console::draw_partial_attributed_line(std::string const & text, std::size_t content_offset, unsigned & x, unsigned y)
+{
+	draw_attributed_text(text, content_offset, x, y);
+	x += utf8::get_width(text) * font_width;
 }
 
 void console::draw_background()
 {
 	RECT rectangle;
 	SetRect(&rectangle, 0, 0, width, height);
-	FillRect(buffer_dc, &rectangle, background_brush);
+	FillRect(buffer_dc, &rectangle, resources.get_background_brush());
 }
 
 void console::draw_content()
 {
 	std::size_t last_newline_offset = scroll_string_offset;
 
-	if(content.empty())
+	if(get_content_length() == 0)
 		return;
 
 	unsigned selection_first_line;
@@ -345,28 +600,27 @@ void console::draw_content()
 
 	determine_selection(selection_first_line, selection_last_line, selection_line_begin, selection_line_end);
 
-	bool first_run = true;
 	for(int current_line = lines_maximum - 1; current_line >= 0;)
 	{
-		std::size_t newline_offset = content.rfind('\n', last_newline_offset - 1);
+		std::size_t newline_offset = find_content_newline(last_newline_offset - 1);
 		std::size_t line_offset;
 		if(newline_offset == std::string::npos)
 			line_offset = 0;
 		else
 			line_offset = newline_offset + 1;
 
-		std::string line = content.substr(line_offset, last_newline_offset - line_offset);
+		std::string line = get_content(line_offset, last_newline_offset);
 
-		unsigned line_length = static_cast<unsigned>(line.length());
-		if(line_length == 0)
+		if(line.empty())
 			current_line--;
 		else
 		{
-			unsigned line_count = ceiling_division(line_length, letters_per_line_maximum);
+			get_row_offsets(line, row_offsets);
+			std::size_t line_count = row_offsets.size();
 			for(; line_count > 0 && current_line >= 0; line_count--, current_line--)
 			{
-				std::size_t offset = static_cast<std::size_t>((line_count - 1) * letters_per_line_maximum);
-				std::size_t length = std::min(static_cast<std::size_t>(letters_per_line_maximum), static_cast<std::size_t>(static_cast<std::size_t>(line_length) - offset));
+				std::size_t offset = row_offsets[line_count - 1];
+				std::size_t length = (line_count < row_offsets.size() ? row_offsets[line_count] : line.length()) - offset;
 				std::string substring = line.substr(offset, length);
 
 				unsigned x = border;
@@ -375,28 +629,27 @@ void console::draw_content()
 				if(selection)
 				{
 					unsigned unsigned_current_line = static_cast<unsigned>(current_line);
-					unsigned substring_length = static_cast<unsigned>(substring.length());
 
-					unsigned end = std::min(selection_line_end, substring_length);
-					unsigned begin = std::min(selection_line_begin, substring_length);
+					unsigned end_columns = selection_line_end;
+					unsigned begin_columns = selection_line_begin;
+					std::size_t end = utf8::fit_columns(substring.c_str(), substring.length(), end_columns);
+					std::size_t begin = utf8::fit_columns(substring.c_str(), substring.length(), begin_columns);
 
 					if(unsigned_current_line == selection_first_line)
 					{
-						std::string unselected_part = substring.substr(0, selection_line_begin);
-						set_text_colour(false);
-						draw_partial_line(unselected_part, x, y);
+						std::string unselected_part = substring.substr(0, begin);
+						draw_partial_attributed_line(unselected_part, line_offset + offset, x, y);
 
 						selection_offset_begin = line_offset + offset + begin;
 						if(current_line == selection_last_line)
 						{
-							unsigned selection_length = end - begin;
+							std::size_t selection_length = end - begin;
 							std::string selected_part = substring.substr(begin, selection_length);
 							set_text_colour(true);
 							draw_partial_line(selected_part, x, y);
 							selection_offset_end = selection_offset_begin + selection_length;
 							unselected_part = substring.substr(end);
-							set_text_colour(false);
-							draw_text(unselected_part, x, y);
+							draw_attributed_text(unselected_part, line_offset + offset + end, x, y);
 						}
 						else
 						{
@@ -417,33 +670,21 @@ void console::draw_content()
 						draw_partial_line(selected_part, x, y);
 						selection_offset_end = line_offset + offset + end;
 						std::string unselected_part = substring.substr(end);
-						set_text_colour(false);
-						draw_text(unselected_part, x, y);
+						draw_attributed_text(unselected_part, line_offset + offset + end, x, y);
 					}
 					else
-					{
-						set_text_colour(false);
-						draw_text(substring, x, y);
-					}
+						draw_attributed_text(substring, line_offset + offset, x, y);
 				}
 				else
 				{
-					draw_text(substring, x, y);
-					if(first_run && allow_input && offset <= command_input_offset)
+					draw_attributed_text(substring, line_offset + offset, x, y);
+					std::size_t caret_offset = history.length() + command_input_offset;
+					std::size_t row_offset = line_offset + offset;
+					if(allow_input && caret_offset >= row_offset && caret_offset < row_offset + length)
 					{
-						first_run = false;
 						POINT line_points[2];
-						unsigned offset = command_input_offset % letters_per_line_maximum;
-						int line_x;
-						int line_y = y + font_height + 1 + scroll_line_offset * font_height;
-						int difference = letters_per_line_maximum - offset;
-						if(difference == 1 || difference == 2)
-						{
-							line_x = (2 - difference) * font_width + border;
-							line_y += font_height;
-						}
-						else
-							line_x = (offset + static_cast<unsigned>(command_input_prefix.length())) * font_width + border;
+						int line_x = border + utf8::get_width(substring.c_str(), caret_offset - row_offset) * font_width;
+						int line_y = y + font_height;
 						line_points[0].x = line_x;
 						line_points[0].y = line_y;
 						line_points[1].x = line_x + font_width;
@@ -509,36 +750,37 @@ void console::draw_scrollbar()
 
 void console::process_content()
 {
-	content = history + command + " ";
-
 	letters_per_line_maximum = std::max((width - 3 * border - scrollbar_width) / font_width, 1u);
 	lines_maximum = std::max((height - 2 * border) / font_height, 1u);
 	//lines_maximum = 1;
 
-	std::vector<unsigned> line_lengths;
-	std::vector<std::string> lines = nil::string::tokenise(content, "\n");
-	for(std::vector<std::string>::iterator i = lines.begin(), end = lines.end(); i != end; i++)
+	bool width_changed = letters_per_line_maximum != content_index.get_width();
+	if(width_changed)
 	{
-		unsigned current_line_length = static_cast<unsigned>(i->length());
-		if(current_line_length)
+		//Keep the content at the bottom of the view in place while the history is reflowed for the new width
+		if(scroll_line_offset > 0 && !scrollbar_click)
 		{
-			unsigned quotient = current_line_length / letters_per_line_maximum;
-			unsigned remainder = current_line_length % letters_per_line_maximum;
-			for(unsigned i = 0; i < quotient; i++)
-				line_lengths.push_back(letters_per_line_maximum);
-			if(remainder)
-				line_lengths.push_back(remainder);
-			(*(line_lengths.end() - 1))++;
+			anchored = true;
+			scroll_anchor = scroll_string_offset;
 		}
-		else
-			line_lengths.push_back(1);
+		content_index.set_width(letters_per_line_maximum);
 	}
-	/*
-	if(!line_lengths.empty())
-		(*(line_lengths.end() - 1))--;
-		*/
 
-	actual_line_count = static_cast<unsigned>(line_lengths.size());
+	std::size_t newline_offset = history.rfind('\n');
+	content_index.append(history, newline_offset == std::string::npos ? 0 : newline_offset + 1);
+	tail_offset = content_index.get_end();
+	content_tail.assign(history, tail_offset, std::string::npos);
+	content_tail += command;
+	//The caret may be placed after the last character of the command
+	content_tail += ' ';
+	tail_rows = count_rows(content_tail.c_str(), content_tail.length(), letters_per_line_maximum);
+
+	if(anchored && scroll_anchor > get_content_length())
+		anchored = false;
+	if(width_changed)
+		reflow_view(anchored ? scroll_anchor : get_content_length());
+
+	actual_line_count = static_cast<unsigned>(content_index.get_row_count() + tail_rows);
 
 	scrollbar_height = height - 4 * border - 2 * scrollbar_width;
 
@@ -549,14 +791,212 @@ void console::process_content()
 	inner_height = std::max(inner_height, scrollbar_inner_width);
 
 	if(scrollbar_click)
+	{
+		anchored = false;
 		scroll_line_offset = original_scroll_line_offset + static_cast<int>(static_cast<float>(-scrollbar_offset) / static_cast<float>(scrollbar_inner_height - inner_height) * (actual_line_count - lines_maximum));
+	}
+	else if(anchored)
+	{
+		scroll_line_offset = static_cast<int>(get_rows_below(scroll_anchor));
+		original_scroll_line_offset = scroll_line_offset;
+	}
 	scroll_line_offset = std::min<int>(scroll_line_offset, actual_line_count - lines_maximum);
 	scroll_line_offset = std::max<int>(scroll_line_offset, 0);
 
-	unsigned scroll_offset_counter = 0;
-	scroll_string_offset = content.length();
-	for(std::vector<unsigned>::reverse_iterator i(line_lengths.end()), end(line_lengths.begin()); i != end && scroll_offset_counter < scroll_line_offset; i++, scroll_offset_counter++)
-		scroll_string_offset -= *i;
+	if(anchored && scroll_line_offset > 0)
+		scroll_string_offset = scroll_anchor;
+	else
+		scroll_string_offset = get_offset_from_bottom(static_cast<unsigned>(scroll_line_offset));
+
+	if(content_index.is_complete())
+		anchored = false;
+	else
+		schedule_reflow();
+}
+
+std::size_t console::get_content_length() const
+{
+	return tail_offset + content_tail.length();
+}
+
+std::string console::get_content(std::size_t begin, std::size_t end) const
+{
+	std::string output;
+	if(begin < tail_offset)
+		output.assign(history, begin, std::min(end, tail_offset) - begin);
+	if(end > tail_offset)
+	{
+		std::size_t tail_begin = std::max(begin, tail_offset) - tail_offset;
+		output.append(content_tail, tail_begin, end - tail_offset - tail_begin);
+	}
+	return output;
+}
+
+std::size_t console::find_content_newline(std::size_t offset) const
+{
+	//The tail holds no newlines, the last one before it ends the last complete line of the history
+	if(offset >= tail_offset)
+	{
+		if(tail_offset == 0)
+			return std::string::npos;
+		offset = tail_offset - 1;
+	}
+	return history.rfind('\n', offset);
+}
+
+void console::reflow_view(std::size_t offset)
+{
+	std::size_t line_count = content_index.get_line_count();
+	if(line_count == 0)
+		return;
+
+	//The rows of the view are made exact first, the rest of the history follows step by step in reflow().
+	//The rows counted are only the bound, a view of lines_maximum rows above and below the offset covers every scroll position
+	//around it.
+	std::size_t line = offset >= tail_offset ? line_count - 1 : content_index.find_line(offset);
+	unsigned rows_above = 0;
+	for(std::size_t i = line + 1; i > 0 && rows_above < lines_maximum; i--)
+	{
+		content_index.reflow_line(history, i - 1);
+		rows_above += content_index.get_estimated_rows(i - 1);
+	}
+	unsigned rows_below = 0;
+	for(std::size_t i = line + 1; i < line_count && rows_below < lines_maximum; i++)
+	{
+		content_index.reflow_line(history, i);
+		rows_below += content_index.get_estimated_rows(i);
+	}
+}
+
+unsigned console::get_rows_below(std::size_t offset)
+{
+	if(offset >= tail_offset)
+	{
+		if(offset == tail_offset)
+			return tail_rows;
+		return tail_rows - count_rows(content_tail.c_str(), offset - tail_offset, letters_per_line_maximum);
+	}
+
+	std::size_t line = content_index.find_line(offset);
+	std::size_t line_begin = content_index.get_line_begin(line);
+	unsigned rows = tail_rows;
+	if(offset < content_index.get_line_end(line))
+	{
+		rows += content_index.get_rows(history, line);
+		if(offset > line_begin)
+			rows -= count_rows(history.c_str() + line_begin, offset - line_begin, letters_per_line_maximum);
+	}
+	return rows + static_cast<unsigned>(content_index.get_rows_after(line));
+}
+
+std::size_t console::get_offset_from_bottom(unsigned rows)
+{
+	//Positions are either row boundaries inside of a line or the newline of the line at the bottom of the view.
+	//Lines which are skipped are counted with their estimated rows, so until reflow() is complete the offset is only approximate
+	//where wide characters make a stale line take more rows than its columns suggest. The view stays anchored to an exact
+	//offset for as long as that is the case.
+	if(rows == 0)
+		return get_content_length();
+
+	if(rows < tail_rows)
+	{
+		::get_row_offsets(content_tail.c_str(), content_tail.length(), letters_per_line_maximum, row_offsets);
+		return tail_offset + row_offsets[tail_rows - rows];
+	}
+	rows -= tail_rows;
+
+	for(std::size_t line = content_index.get_line_count(); line > 0;)
+	{
+		line--;
+		std::size_t line_end = content_index.get_line_end(line);
+		if(rows == 0)
+			return line_end;
+
+		if(rows < content_index.get_estimated_rows(line))
+		{
+			unsigned line_rows = content_index.get_rows(history, line);
+			if(rows < line_rows)
+			{
+				std::size_t line_begin = content_index.get_line_begin(line);
+				::get_row_offsets(history.c_str() + line_begin, line_end - line_begin, letters_per_line_maximum, row_offsets);
+				return line_begin + row_offsets[line_rows - rows];
+			}
+		}
+		rows -= std::min(rows, content_index.get_estimated_rows(line));
+	}
+	return 0;
+}
+
+void console::schedule_reflow()
+{
+	if(window_handle != 0 && !reflow_scheduled)
+	{
+		set_timer(reflow_timer);
+		reflow_scheduled = true;
+	}
+}
+
+bool console::timer(unsigned identifier)
+{
+	if(identifier <= timer_base || identifier > timer_base + timer_count)
+		return false;
+	identifier -= timer_base;
+	if(identifier == reflow_timer && !reflow())
+	{
+		kill_timer(reflow_timer);
+		reflow_scheduled = false;
+	}
+	else if(identifier == pipeline_timer && running_pipeline != 0)
+		run_pipeline();
+	else if(identifier == commands_timer)
+	{
+		kill_timer(commands_timer);
+		commands_scheduled = false;
+		run_pending_commands();
+	}
+	return true;
+}
+
+void console::set_timer(unsigned identifier)
+{
+	SetTimer(window_handle, timer_base + identifier, 0, 0);
+}
+
+void console::kill_timer(unsigned identifier)
+{
+	KillTimer(window_handle, timer_base + identifier);
+}
+
+bool console::idle()
+{
+	if(running_pipeline != 0)
+		run_pipeline();
+	else if(!pending_commands.empty())
+		run_pending_commands();
+	//A finished pipeline may still be followed by queued commands
+	bool busy = running_pipeline != 0 || !pending_commands.empty();
+	return reflow() || busy;
+}
+
+bool console::reflow()
+{
+	if(!active || content_index.is_complete())
+		return false;
+
+	//Reflow the remaining history in slices small enough not to delay input processing
+	unsigned long long start = get_microseconds();
+	while(!content_index.reflow(history, reflow_batch_size))
+	{
+		if(get_microseconds() - start >= reflow_time_slice)
+			return true;
+	}
+	update();
+	return false;
+}
+
+void console::get_row_offsets(std::string const & line, std::vector<std::size_t> & offsets)
+{
+	::get_row_offsets(line.c_str(), line.length(), letters_per_line_maximum, offsets);
 }
 
 void console::determine_selection(unsigned & selection_first_line, unsigned & selection_last_line, unsigned & selection_line_begin, unsigned & selection_line_end)
@@ -591,6 +1031,17 @@ void console::set_text_colour(bool use_selection_colour)
 	SetBkColor(buffer_dc, use_selection_colour ? text_colour : background_colour);
 }
 
+COLORREF console::set_attribute_colour(text_attribute const & attribute)
+{
+	COLORREF foreground = attribute.foreground == default_colour ? text_colour : attribute.foreground;
+	COLORREF background = attribute.background == default_colour ? background_colour : attribute.background;
+	if(attribute.flags & text_flag_inverse)
+		std::swap(foreground, background);
+	SetTextColor(buffer_dc, foreground);
+	SetBkColor(buffer_dc, background);
+	return foreground;
+}
+
 unsigned console::ceiling_division(unsigned left, unsigned right)
 {
 	return static_cast<unsigned>(std::ceil(static_cast<float>(left) / static_cast<float>(right)));
@@ -598,6 +1049,7 @@ unsigned console::ceiling_division(unsigned left, unsigned right)
 
 void console::scroll_up()
 {
+	anchored = false;
 	scroll_line_offset = std::min<int>(scroll_line_offset + 1, actual_line_count - lines_maximum);
 	original_scroll_line_offset = scroll_line_offset;
 	update();
@@ -605,6 +1057,7 @@ void console::scroll_up()
 
 void console::scroll_down()
 {
+	anchored = false;
 	if(scroll_line_offset > 0)
 		scroll_line_offset--;
 	original_scroll_line_offset = scroll_line_offset;
@@ -613,105 +1066,315 @@ void console::scroll_down()
 
 void console::command_input()
 {
-	history += command_input_prefix;
+	print(command_input_prefix);
 	update();
 }
 
 void console::hit_return()
 {
-	history += command + "\n";
-	parse_command();
+	print(command + "\n");
+	parse_command(command);
 	clear_command();
-	command_input();
+	if(running_pipeline != 0)
+		run_pipeline();
+	else if(!pending_commands.empty())
+	{
+		print(command_input_prefix);
+		run_pending_commands();
+	}
+	else
+		command_input();
 }
 
-void console::clear_command()
+void console::print(std::string const & text)
 {
-	command.clear();
-	command_input_offset = 0;
+	session_log.write(text);
+	parser.process(text, history, history_attributes);
+	std::size_t erased_offset = parser.take_erased_offset();
+	if(erased_offset < content_index.get_end())
+		content_index.truncate(erased_offset);
 }
 
-void console::parse_command()
+//log [-sync <milliseconds>] <file> | log off | log
+void console::log_command(std::string const & argument)
 {
-	std::string first_token;
-	std::size_t space_offset = command.find(' ');
-	if(space_offset == std::string::npos)
-		first_token = command;
-	else
-		first_token = command.substr(0, space_offset);
+	if(argument.empty())
+	{
+		if(!session_log.is_open())
+		{
+			print("Logging is off\n");
+			return;
+		}
+		std::ostringstream stream;
+		stream << "Logging to " << session_log.get_path() << ", " << session_log.get_written_bytes() << " bytes written, " << session_log.get_dropped_bytes() << " bytes dropped\n";
+		print(stream.str());
+		return;
+	}
 
-	if(first_token == "pwd")
-		history += working_directory + "\n";
-	else if(first_token == "dir")
+	if(argument == "off")
 	{
-		std::string target;
-		if(command.length() > 4)
-			target = command.substr(space_offset + 1);
-		else
-			target = working_directory;
-		bool success = read_directory(target, directories, files);
-		if(!success)
+		session_log.close();
+		print("Logging is off\n");
+		return;
+	}
+
+	unsigned sync_interval = 0;
+	std::string path = argument;
+	if(argument.compare(0, 6, "-sync ") == 0)
+	{
+		std::istringstream stream(argument.substr(6));
+		if(!(stream >> sync_interval))
 		{
-			history += "Failed to read directory\n";
+			print("Invalid sync interval\n");
 			return;
 		}
+		std::getline(stream >> std::ws, path);
+	}
+	if(path.empty())
+	{
+		print("Missing file\n");
+		return;
+	}
+
+	path = resolve_path(path, working_directory);
+	if(!session_log.open(path, sync_interval))
+	{
+		print("Failed to open log file\n");
+		return;
+	}
+	print("Logging to " + path + "\n");
+}
 
-		for(std::vector<std::string>::const_iterator i = directories.begin(), end = directories.end(); i != end; i++)
-			history += "[D] " + *i + "\n";
+bool console::run_pipeline()
+{
+	//Batches are printed as soon as they arrive, the pipeline yields to the message loop after every time slice
+	unsigned long long start = get_microseconds();
+	bool more;
+	do
+	{
+		pipeline_batch.clear();
+		more = running_pipeline->pull(pipeline_batch);
+		print(pipeline_batch.text);
+	}
+	while(more && get_microseconds() - start < pipeline_time_slice);
 
-		for(std::vector<std::string>::const_iterator i = files.begin(), end = files.end(); i != end; i++)
-			history += *i + "\n";
+	if(!more)
+	{
+		finish_pipeline();
+		return false;
 	}
-	else if(first_token == "cd")
+
+	if(window_handle != 0 && !pipeline_scheduled)
 	{
-		if(command.length() < 4)
+		set_timer(pipeline_timer);
+		pipeline_scheduled = true;
+	}
+	update();
+	return true;
+}
+
+void console::finish_pipeline()
+{
+	if(pipeline_scheduled)
+	{
+		kill_timer(pipeline_timer);
+		pipeline_scheduled = false;
+	}
+	delete running_pipeline;
+	running_pipeline = 0;
+	if(!pending_commands.empty())
+	{
+		//The remaining commands of a paste continue from the message loop instead of recursing
+		print(command_input_prefix);
+		schedule_pending_commands();
+		return;
+	}
+	allow_input = true;
+	layout_suspended = false;
+	command_input();
+}
+
+void console::paste()
+{
+	std::string text;
+	if(!get_clipboard_text(text) || text.empty())
+		return;
+	paste_start = get_microseconds();
+	paste_bytes = text.length();
+	text = filter_pasted_text(text);
+
+	//Text up to the first newline completes the command being edited and the text after the last one starts the next command
+	std::size_t first_newline = text.find('\n');
+	if(first_newline == std::string::npos)
+	{
+		paste_lines = 1;
+		command.insert(command_input_offset, text);
+		command_input_offset += text.length();
+		update();
+		return;
+	}
+
+	std::string remainder = command.substr(command_input_offset);
+	pending_commands.push_back(queued_command(command.substr(0, command_input_offset) + text.substr(0, first_newline), 0));
+	std::size_t last_newline = text.rfind('\n');
+	for(std::size_t offset = first_newline + 1; offset <= last_newline;)
+	{
+		std::size_t newline = text.find('\n', offset);
+		pending_commands.push_back(queued_command(text.substr(offset, newline - offset), 0));
+		offset = newline + 1;
+	}
+	paste_lines = pending_commands.size() + 1;
+	command = text.substr(last_newline + 1);
+	command_input_offset = command.length();
+	command += remainder;
+	run_pending_commands();
+}
+
+bool console::run_pending_commands()
+{
+	//Queued commands run back to back and the view is only laid out once per time slice
+	unsigned long long start = get_microseconds();
+	allow_input = false;
+	while(!pending_commands.empty() && running_pipeline == 0 && get_microseconds() - start < commands_time_slice)
+	{
+		std::string line;
+		line.swap(pending_commands.front().line);
+		command_depth = pending_commands.front().depth;
+		pending_commands.pop_front();
+		print(line + "\n");
+		parse_command(line);
+		command_depth = 0;
+		if(running_pipeline != 0)
+			run_pipeline();
+		else
+			print(command_input_prefix);
+	}
+
+	if(running_pipeline != 0)
+		return true;
+	if(!pending_commands.empty())
+	{
+		schedule_pending_commands();
+		update();
+		return true;
+	}
+	allow_input = true;
+	layout_suspended = false;
+	update();
+	return false;
+}
+
+void console::schedule_pending_commands()
+{
+	if(window_handle != 0 && !commands_scheduled)
+	{
+		set_timer(commands_timer);
+		commands_scheduled = true;
+	}
+}
+
+void console::print_statistics()
+{
+	std::ostringstream stream;
+	if(paste_bytes == 0)
+		stream << "No paste yet\n";
+	else
+	{
+		stream << "Last paste: " << paste_bytes << " bytes, " << paste_lines << " lines, ";
+		if(paste_start != 0)
+			stream << "still running\n";
+		else
+			stream << paste_duration << " us to screen\n";
+	}
+	stream << format_startup_trace();
+	print(stream.str());
+}
+
+void console::clear_command()
+{
+	command.clear();
+	command_input_offset = 0;
+}
+
+void console::parse_command(std::string const & line)
+{
+	std::string first_token;
+	std::size_t space_offset = line.find(' ');
+	if(space_offset == std::string::npos)
+		first_token = line;
+	else
+		first_token = line.substr(0, space_offset);
+
+	if(first_token == "cd")
+	{
+		if(line.length() < 4)
 		{
-			history += "Missing argument\n";
+			print("Missing argument\n");
 			return;
 		}
-		std::string directory = command.substr(3);
-		BOOL result = SetCurrentDirectory(directory.c_str());
+		std::string directory = line.substr(3);
+		//Relative paths are resolved against the directory of this session
+		SetCurrentDirectoryW(utf8::to_wide(working_directory).c_str());
+		BOOL result = SetCurrentDirectoryW(utf8::to_wide(directory).c_str());
 		if(result == 0)
 		{
-			history += "Failed to change directory\n";
+			print("Failed to change directory\n");
 			return;
 		}
 		set_working_directory();
 	}
+	else if(first_token == "stats")
+		print_statistics();
+	else if(first_token == "log")
+		log_command(space_offset == std::string::npos ? std::string() : nil::string::trim(line.substr(space_offset + 1)));
+	else if(first_token == "run")
+	{
+		std::string path = space_offset == std::string::npos ? std::string() : nil::string::trim(line.substr(space_offset + 1));
+		if(path.empty())
+			print("Missing file\n");
+		else if(command_depth >= script_depth_maximum)
+			print("Scripts are nested too deeply\n");
+		else if(!run_script(path))
+			print("Failed to read script\n");
+	}
 	else
-		history += "No such command\n";
-}
-
-void console::process_find_data(WIN32_FIND_DATA const & find_data, std::vector<std::string> & directories, std::vector<std::string> & files)
-{
-	std::string name(find_data.cFileName);
-	if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-		directories.push_back(name);
-	else
-		files.push_back(name);
+	{
+		//Everything else is a pipeline of builtins, it runs step by step from hit_return
+		std::string error;
+		running_pipeline = create_pipeline(line, working_directory, listings, error);
+		if(running_pipeline == 0)
+			print(error + "\n");
+		else
+			allow_input = false;
+	}
 }
 
-bool console::read_directory(std::string const & path, std::vector<std::string> & directories, std::vector<std::string> & files)
+bool console::decode_character_input(unsigned key, unsigned & code_point)
 {
-	WIN32_FIND_DATA find_data;
-	std::string target = path + "\\*";
-	HANDLE find_handle = FindFirstFile(target.c_str(), &find_data);
-	if(find_handle == INVALID_HANDLE_VALUE)
+	//The window receives UTF-16, characters outside of the basic plane arrive as two surrogates
+	if(key >= 0xd800 && key <= 0xdbff)
+	{
+		high_surrogate = key;
 		return false;
-	FindNextFile(find_handle, &find_data);
-	directories.clear();
-	files.clear();
-	while(FindNextFile(find_handle, &find_data))
-		process_find_data(find_data, directories, files);
+	}
+	else if(key >= 0xdc00 && key <= 0xdfff)
+	{
+		if(high_surrogate == 0)
+			return false;
+		code_point = 0x10000 + ((high_surrogate - 0xd800) << 10) + (key - 0xdc00);
+		high_surrogate = 0;
+		return true;
+	}
+	high_surrogate = 0;
+	code_point = key;
 	return true;
 }
 
 void console::set_working_directory()
 {
-	char buffer[1024];
-	GetCurrentDirectory(static_cast<DWORD>(nil::countof(buffer)), buffer);
-	working_directory = buffer;
-	read_directory(working_directory, directories, files);
+	wchar_t buffer[1024];
+	GetCurrentDirectoryW(static_cast<DWORD>(nil::countof(buffer)), buffer);
+	working_directory = utf8::from_wide(buffer);
 }
 
 void console::process_tab()
@@ -722,35 +1385,34 @@ void console::process_tab()
 		{
 			tab_strings.clear();
 
-			std::size_t last_space;
-			std::string target;
-			if(command.empty())
+			directory_listing const * listing = listings.get(working_directory);
+			if(listing == 0)
 			{
-				last_space = 0;
-				for(std::vector<std::string>::const_iterator i = directories.begin(), end = directories.end(); i != end; i++)
-					tab_strings.push_back(*i);
-				for(std::vector<std::string>::const_iterator i = files.begin(), end = files.end(); i != end; i++)
-					tab_strings.push_back(*i);
+				MessageBeep(MB_ICONASTERISK);
+				return;
 			}
-			else
+			std::size_t last_space = 0;
+			std::string target;
+			glob_pattern filter;
+			if(!command.empty())
 			{
 				last_space = command.rfind(' ', command_input_offset) + 1;
 				if(last_space == std::string::npos)
 					last_space = 0;
 				target = nil::string::trim(command.substr(last_space, command_input_offset - last_space));
-				target = nil::string::to_lower(target);
-				std::size_t target_length = target.length();
-				for(std::vector<std::string>::const_iterator i = directories.begin(), end = directories.end(); i != end; i++)
-				{
-					std::string const & directory = *i;
-					if(target == nil::string::to_lower(directory.substr(0, target_length)))
-						tab_strings.push_back(directory);
-				}
-				for(std::vector<std::string>::const_iterator i = files.begin(), end = files.end(); i != end; i++)
+				//Words with wildcards complete to the names matching them and any other word to the names it is a prefix of
+				std::string error;
+				if(!glob_pattern::has_wildcards(target) || !filter.compile(target, error))
+					filter.compile(glob_pattern::escape(target) + "*", error);
+			}
+
+			//Directories are offered before files
+			for(int directories = 1; directories >= 0; directories--)
+			{
+				for(std::size_t i = 0, count = listing->get_count(); i < count; i++)
 				{
-					std::string const & file = *i;
-					if(target == nil::string::to_lower(file.substr(0, target_length)))
-						tab_strings.push_back(file);
+					if(listing->is_directory(i) == (directories != 0) && filter.matches(listing->get_name_begin(i), listing->get_name_end(i)))
+						tab_strings.push_back(listing->get_name(i));
 				}
 			}
 
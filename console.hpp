@@ -1,12 +1,22 @@
+#pragma once
+
+#include <deque>
 #include <string>
 #include <vector>
 
 #include <windows.h>
 
+#include "render_resources.hpp"
+#include "directory.hpp"
+#include "pipeline.hpp"
+#include "async_log.hpp"
+#include "vt_parser.hpp"
+#include "wrap_index.hpp"
+
 class console
 {
 public:
-	console();
+	console(render_resources & resources, directory_cache & listings);
 	~console();
 	void initialise(HWND new_window_handle);
 	void input(unsigned key);
@@ -18,10 +28,29 @@ public:
 	void mouse_wheel(int direction);
 	void draw();
 	void resize();
+	void set_size(unsigned new_width, unsigned new_height);
+	//Returns false if the timer belongs to another session
+	bool timer(unsigned identifier);
+	bool idle();
+
+	//Sessions in the background keep running their commands but only keep the output, the layout is performed once they are activated again
+	void activate();
+	void deactivate();
+
+	std::string const & get_working_directory() const;
+	std::string const & get_history() const;
+
+	//Queues the commands of a script, they run back to back without any layout until the last one is done
+	bool run_script(std::string const & path);
 
 private:
+	render_resources & resources;
+	directory_cache & listings;
+
 	bool initialised;
+	bool active;
 	HWND window_handle;
+	unsigned timer_base;
 	HWND scrollbar_handle;
 	unsigned width;
 	unsigned height;
@@ -32,12 +61,8 @@ private:
 	unsigned border;
 
 	HDC buffer_dc;
-	HBITMAP bitmap;
-	HFONT font;
 	unsigned font_width;
 	unsigned font_height;
-	HBRUSH background_brush;
-	HPEN foreground_pen;
 
 	bool selection;
 	unsigned selection_start_x;
@@ -53,8 +78,9 @@ private:
 	unsigned scrollbar_y;
 	int scrollbar_offset;
 
-	std::string content;
 	std::string history;
+	std::vector<attribute_span> history_attributes;
+	vt_parser parser;
 	std::string command;
 
 	std::string command_input_prefix;
@@ -81,27 +107,74 @@ private:
 
 	std::string working_directory;
 
-	std::vector<std::string> directories;
-	std::vector<std::string> files;
-
 	bool tabbing;
 	std::vector<std::string> tab_strings;
 	std::size_t tab_strings_offset;
 	std::size_t tab_word_offset;
 	std::size_t tab_word_length;
 
-	void create_dc(HDC window_dc);
-	void create_font(std::string const & name, unsigned width, unsigned height);
-	void free_bitmap_and_dc();
+	unsigned high_surrogate;
+	std::vector<std::size_t> row_offsets;
+
+	//The content is the history followed by the command. Only the tail of it after the last complete line of the history is
+	//copied, the lines before it are read from the history in place.
+	wrap_index content_index;
+	std::size_t tail_offset;
+	std::string content_tail;
+	unsigned tail_rows;
+	bool anchored;
+	std::size_t scroll_anchor;
+	bool reflow_scheduled;
+
+	pipeline_stage * running_pipeline;
+	line_batch pipeline_batch;
+	bool pipeline_scheduled;
+
+	async_log session_log;
+
+	//Commands of a paste or a script, the depth is the number of scripts they were read from
+	struct queued_command
+	{
+		std::string line;
+		unsigned depth;
+
+		queued_command(std::string const & line, unsigned depth);
+	};
+
+	std::deque<queued_command> pending_commands;
+	//Depth of the command which is being run, scripts started by it are queued one level deeper
+	unsigned command_depth;
+	bool commands_scheduled;
+	bool layout_suspended;
+
+	unsigned long long paste_start;
+	unsigned long long paste_duration;
+	std::size_t paste_bytes;
+	std::size_t paste_lines;
+
 	void draw_text(std::string const & text, unsigned x, unsigned y);
 	void draw_partial_line(std::string const & text, unsigned & x, unsigned y);
+	void draw_attributed_text(std::string const & text, std::size_t content_offset, unsigned x, unsigned y);
+	void draw_partial_attributed_line(std::string const & text, std::size_t content_offset, unsigned & x, unsigned y);
 	void draw_background();
 	void draw_content();
 	void draw_rectangle(unsigned x, unsigned y, unsigned width, unsigned height);
 	void draw_scrollbar();
 	void set_text_colour(bool use_selection_colour);
+	COLORREF set_attribute_colour(text_attribute const & attribute);
 
 	void process_content();
+	std::size_t get_content_length() const;
+	std::string get_content(std::size_t begin, std::size_t end) const;
+	std::size_t find_content_newline(std::size_t offset) const;
+	void get_row_offsets(std::string const & line, std::vector<std::size_t> & offsets);
+	void reflow_view(std::size_t offset);
+	unsigned get_rows_below(std::size_t offset);
+	std::size_t get_offset_from_bottom(unsigned rows);
+	void schedule_reflow();
+	bool reflow();
+	void set_timer(unsigned identifier);
+	void kill_timer(unsigned identifier);
 	void determine_selection(unsigned & selection_first_line, unsigned & selection_last_line, unsigned & selection_line_begin, unsigned & selection_line_end);
 
 	void update();
@@ -116,10 +189,18 @@ private:
 	void hit_return();
 
 	void clear_command();
+	void print(std::string const & text);
+
+	void parse_command(std::string const & line);
+	void log_command(std::string const & argument);
+	void print_statistics();
+	void paste();
+	bool run_pending_commands();
+	void schedule_pending_commands();
+	bool run_pipeline();
+	void finish_pipeline();
+	bool decode_character_input(unsigned key, unsigned & code_point);
 
-	void parse_command();
-	void process_find_data(WIN32_FIND_DATA const & find_data, std::vector<std::string> & directories, std::vector<std::string> & files);
-	bool read_directory(std::string const & path, std::vector<std::string> & directories, std::vector<std::string> & files);
 	void set_working_directory();
 
 	void process_tab();
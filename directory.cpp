@@ -0,0 +1,484 @@
+#include "directory.hpp"
+
+#include <algorithm>
+
+#include <windows.h>
+
+#include <nil/string.hpp>
+
+#include "utf8.hpp"
+#include "timing.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+	std::size_t const maximum_entry_count = 64;
+
+	//Below this many entries sorting on a single thread is faster than starting the workers
+	std::size_t const parallel_sort_threshold = 16 * 1024;
+
+	unsigned long long combine(DWORD high, DWORD low)
+	{
+		return (static_cast<unsigned long long>(high) << 32) | low;
+	}
+
+	int compare_names(char const * left, char const * left_end, char const * right, char const * right_end)
+	{
+		for(; left != left_end && right != right_end; left++, right++)
+		{
+			char left_character = utf8::lower_ascii(*left);
+			char right_character = utf8::lower_ascii(*right);
+			if(left_character != right_character)
+				return static_cast<unsigned char>(left_character) < static_cast<unsigned char>(right_character) ? -1 : 1;
+		}
+		if(left != left_end)
+			return 1;
+		return right != right_end ? -1 : 0;
+	}
+
+	//The lowered name from an offset on in big endian order, keys of names compare like the names as far as they go
+	unsigned long long get_name_key(char const * name, char const * end, std::size_t depth)
+	{
+		name += std::min(depth, static_cast<std::size_t>(end - name));
+		unsigned long long key = 0;
+		for(int i = 0; i < 8; i++)
+		{
+			char character = name != end ? utf8::lower_ascii(*name++) : 0;
+			key = (key << 8) | static_cast<unsigned char>(character);
+		}
+		return key;
+	}
+
+	//Entries are sorted by a key which is kept next to their index so that most comparisons never have to look at the columns
+	struct sort_entry
+	{
+		unsigned long long key;
+		unsigned index;
+	};
+
+	typedef std::vector<sort_entry>::iterator entry_iterator;
+
+	bool is_key_less(sort_entry const & left, sort_entry const & right)
+	{
+		return left.key != right.key ? left.key < right.key : left.index < right.index;
+	}
+
+	void sort_by_name(directory_listing const & listing, entry_iterator begin, entry_iterator end, std::size_t depth);
+
+	//Runs of entries with the same key are sorted by the next eight bytes of their names
+	void sort_ties(directory_listing const & listing, entry_iterator begin, entry_iterator end, std::size_t depth, bool name_keys)
+	{
+		while(begin != end)
+		{
+			entry_iterator run_end = begin + 1;
+			while(run_end != end && run_end->key == begin->key)
+				run_end++;
+			//A name key ending in a zero byte covered the rest of the names, equal names keep the order of their indices
+			if(run_end - begin > 1 && (!name_keys || (begin->key & 0xff) != 0))
+				sort_by_name(listing, begin, run_end, depth);
+			begin = run_end;
+		}
+	}
+
+	void sort_by_name(directory_listing const & listing, entry_iterator begin, entry_iterator end, std::size_t depth)
+	{
+		for(entry_iterator i = begin; i != end; i++)
+			i->key = get_name_key(listing.get_name_begin(i->index), listing.get_name_end(i->index), depth);
+		std::sort(begin, end, is_key_less);
+		sort_ties(listing, begin, end, depth + 8, true);
+	}
+
+	void sort_entries(directory_listing const & listing, listing_order order, entry_iterator begin, entry_iterator end)
+	{
+		if(order == listing_order_name)
+		{
+			sort_by_name(listing, begin, end, 0);
+			return;
+		}
+		for(entry_iterator i = begin; i != end; i++)
+			i->key = order == listing_order_size ? listing.get_size(i->index) : listing.get_write_time(i->index);
+		std::sort(begin, end, is_key_less);
+		sort_ties(listing, begin, end, 0, false);
+	}
+
+	//Sorted runs are merged by the columns themselves since their keys end up at different depths of the names
+	class entry_order
+	{
+	public:
+		entry_order(directory_listing const & listing, listing_order order):
+			listing(&listing),
+			order(order)
+		{
+		}
+
+		bool operator()(sort_entry const & left, sort_entry const & right) const
+		{
+			unsigned left_index = left.index;
+			unsigned right_index = right.index;
+			if(order == listing_order_size && listing->get_size(left_index) != listing->get_size(right_index))
+				return listing->get_size(left_index) < listing->get_size(right_index);
+			if(order == listing_order_time && listing->get_write_time(left_index) != listing->get_write_time(right_index))
+				return listing->get_write_time(left_index) < listing->get_write_time(right_index);
+			int comparison = compare_names(listing->get_name_begin(left_index), listing->get_name_end(left_index), listing->get_name_begin(right_index), listing->get_name_end(right_index));
+			return comparison != 0 ? comparison < 0 : left_index < right_index;
+		}
+
+	private:
+		directory_listing const * listing;
+		listing_order order;
+	};
+
+	class sort_task: public pool_task
+	{
+	public:
+		sort_task(directory_listing const & listing, listing_order order, entry_iterator begin, entry_iterator end):
+			listing(listing),
+			order(order),
+			begin(begin),
+			end(end)
+		{
+		}
+
+		void run(thread_pool & pool, unsigned worker)
+		{
+			sort_entries(listing, order, begin, end);
+		}
+
+	private:
+		directory_listing const & listing;
+		listing_order order;
+		entry_iterator begin;
+		entry_iterator end;
+	};
+
+	class merge_task: public pool_task
+	{
+	public:
+		merge_task(entry_iterator begin, entry_iterator middle, entry_iterator end, entry_order const & order):
+			begin(begin),
+			middle(middle),
+			end(end),
+			order(order)
+		{
+		}
+
+		void run(thread_pool & pool, unsigned worker)
+		{
+			std::inplace_merge(begin, middle, end, order);
+		}
+
+	private:
+		entry_iterator begin;
+		entry_iterator middle;
+		entry_iterator end;
+		entry_order order;
+	};
+}
+
+void directory_listing::clear()
+{
+	names.clear();
+	name_offsets.clear();
+	sizes.clear();
+	write_times.clear();
+	attributes.clear();
+}
+
+void directory_listing::add(std::string const & name, WIN32_FIND_DATAW const & find_data)
+{
+	name_offsets.push_back(static_cast<unsigned>(names.length()));
+	names += name;
+	sizes.push_back(combine(find_data.nFileSizeHigh, find_data.nFileSizeLow));
+	write_times.push_back(combine(find_data.ftLastWriteTime.dwHighDateTime, find_data.ftLastWriteTime.dwLowDateTime));
+	attributes.push_back(find_data.dwFileAttributes);
+}
+
+void directory_listing::add(directory_listing const & source, std::size_t entry)
+{
+	name_offsets.push_back(static_cast<unsigned>(names.length()));
+	names.append(source.get_name_begin(entry), source.get_name_end(entry));
+	sizes.push_back(source.sizes[entry]);
+	write_times.push_back(source.write_times[entry]);
+	attributes.push_back(source.attributes[entry]);
+}
+
+void directory_listing::swap(directory_listing & other)
+{
+	names.swap(other.names);
+	name_offsets.swap(other.name_offsets);
+	sizes.swap(other.sizes);
+	write_times.swap(other.write_times);
+	attributes.swap(other.attributes);
+}
+
+std::size_t directory_listing::get_count() const
+{
+	return name_offsets.size();
+}
+
+std::string directory_listing::get_name(std::size_t entry) const
+{
+	return std::string(get_name_begin(entry), get_name_end(entry));
+}
+
+char const * directory_listing::get_name_begin(std::size_t entry) const
+{
+	return names.c_str() + name_offsets[entry];
+}
+
+char const * directory_listing::get_name_end(std::size_t entry) const
+{
+	return names.c_str() + (entry + 1 < name_offsets.size() ? name_offsets[entry + 1] : names.length());
+}
+
+unsigned long long directory_listing::get_size(std::size_t entry) const
+{
+	return sizes[entry];
+}
+
+unsigned long long directory_listing::get_write_time(std::size_t entry) const
+{
+	return write_times[entry];
+}
+
+DWORD directory_listing::get_attributes(std::size_t entry) const
+{
+	return attributes[entry];
+}
+
+bool directory_listing::is_directory(std::size_t entry) const
+{
+	return (attributes[entry] & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+std::size_t directory_listing::get_memory_usage() const
+{
+	return names.capacity() + name_offsets.capacity() * sizeof(unsigned) + sizes.capacity() * sizeof(unsigned long long) + write_times.capacity() * sizeof(unsigned long long) + attributes.capacity() * sizeof(DWORD);
+}
+
+void directory_listing::sort(listing_order order, unsigned worker_count)
+{
+	std::size_t count = get_count();
+	std::vector<sort_entry> permutation(count);
+	for(std::size_t i = 0; i < count; i++)
+		permutation[i].index = static_cast<unsigned>(i);
+
+	//Only the keys and indices are sorted, the columns are rearranged once at the end
+	entry_order comparison(*this, order);
+	if(worker_count < 2 || count < parallel_sort_threshold)
+		sort_entries(*this, order, permutation.begin(), permutation.end());
+	else
+	{
+		//Every worker sorts a run of its own, then neighbouring runs are merged in pairs until only one is left
+		thread_pool pool(worker_count);
+		std::vector<std::size_t> boundaries;
+		for(unsigned i = 0; i <= worker_count; i++)
+			boundaries.push_back(count * i / worker_count);
+		for(unsigned i = 0; i < worker_count; i++)
+			pool.submit(new sort_task(*this, order, permutation.begin() + boundaries[i], permutation.begin() + boundaries[i + 1]));
+		pool.wait();
+
+		while(boundaries.size() > 2)
+		{
+			std::vector<std::size_t> merged_boundaries;
+			std::size_t i = 0;
+			for(; i + 2 < boundaries.size(); i += 2)
+			{
+				pool.submit(new merge_task(permutation.begin() + boundaries[i], permutation.begin() + boundaries[i + 1], permutation.begin() + boundaries[i + 2], comparison));
+				merged_boundaries.push_back(boundaries[i]);
+			}
+			if(i + 1 < boundaries.size())
+				merged_boundaries.push_back(boundaries[i]);
+			merged_boundaries.push_back(boundaries.back());
+			pool.wait();
+			boundaries.swap(merged_boundaries);
+		}
+	}
+
+	directory_listing sorted;
+	sorted.names.reserve(names.length());
+	sorted.name_offsets.reserve(count);
+	sorted.sizes.reserve(count);
+	sorted.write_times.reserve(count);
+	sorted.attributes.reserve(count);
+	for(std::vector<sort_entry>::const_iterator i = permutation.begin(), end = permutation.end(); i != end; i++)
+		sorted.add(*this, i->index);
+	swap(sorted);
+}
+
+void directory_listing::compact()
+{
+	std::string(names).swap(names);
+	std::vector<unsigned>(name_offsets).swap(name_offsets);
+	std::vector<unsigned long long>(sizes).swap(sizes);
+	std::vector<unsigned long long>(write_times).swap(write_times);
+	std::vector<DWORD>(attributes).swap(attributes);
+}
+
+bool read_directory(std::string const & path, directory_listing & listing)
+{
+	WIN32_FIND_DATAW find_data;
+	std::wstring target = utf8::to_wide(path + "\\*");
+	HANDLE find_handle = FindFirstFileW(target.c_str(), &find_data);
+	if(find_handle == INVALID_HANDLE_VALUE)
+		return false;
+	listing.clear();
+	do
+	{
+		//Roots of drives have no entries for . and .. so they are not simply the first two
+		wchar_t const * name = find_data.cFileName;
+		if(name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0)))
+			continue;
+		listing.add(utf8::from_wide(name), find_data);
+	}
+	while(FindNextFileW(find_handle, &find_data));
+	FindClose(find_handle);
+	//Listings stay in the cache so the room left for growing is given back
+	listing.compact();
+	return true;
+}
+
+bool is_absolute_path(std::string const & path)
+{
+	return (path.length() >= 2 && path[1] == ':') || (!path.empty() && (path[0] == '\\' || path[0] == '/'));
+}
+
+std::string resolve_path(std::string const & path, std::string const & working_directory)
+{
+	return is_absolute_path(path) ? path : working_directory + "\\" + path;
+}
+
+directory_cache::directory_cache():
+	prefetch_thread(0),
+	prefetch_window(0),
+	prefetch_message(0),
+	prefetch_change_handle(INVALID_HANDLE_VALUE),
+	prefetch_success(false)
+{
+}
+
+directory_cache::~directory_cache()
+{
+	finish_prefetch();
+	while(!entries.empty())
+		erase(entries.begin());
+}
+
+directory_listing const * directory_cache::get(std::string const & path)
+{
+	directory_listing const * listing = find(path);
+	return listing != 0 ? listing : refresh(path);
+}
+
+directory_listing const * directory_cache::refresh(std::string const & path)
+{
+	std::string key = nil::string::to_lower(path);
+	HANDLE change_handle = watch_directory(path);
+	directory_listing listing;
+	if(!read_directory(path, listing))
+	{
+		if(change_handle != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(change_handle);
+		entry_map::iterator iterator = entries.find(key);
+		if(iterator != entries.end())
+			erase(iterator);
+		return 0;
+	}
+	return store(key, listing, change_handle);
+}
+
+directory_listing const * directory_cache::find(std::string const & path)
+{
+	//Paths are case insensitive on Windows so all spellings share an entry
+	std::string key = nil::string::to_lower(path);
+	if(prefetch_thread != 0 && key == nil::string::to_lower(prefetch_path))
+		finish_prefetch();
+	entry_map::iterator iterator = entries.find(key);
+	if(iterator == entries.end() || !is_current(iterator->second))
+		return 0;
+	iterator->second.time = get_microseconds();
+	return &iterator->second.listing;
+}
+
+void directory_cache::prefetch(std::string const & path, HWND window_handle, UINT message)
+{
+	if(prefetch_thread != 0)
+		return;
+	prefetch_path = path;
+	prefetch_window = window_handle;
+	prefetch_message = message;
+	prefetch_thread = CreateThread(0, 0, &prefetch_entry, this, 0, 0);
+}
+
+bool directory_cache::finish_prefetch()
+{
+	if(prefetch_thread == 0)
+		return false;
+	WaitForSingleObject(prefetch_thread, INFINITE);
+	CloseHandle(prefetch_thread);
+	prefetch_thread = 0;
+	if(prefetch_success)
+		store(nil::string::to_lower(prefetch_path), prefetch_listing, prefetch_change_handle);
+	else if(prefetch_change_handle != INVALID_HANDLE_VALUE)
+		FindCloseChangeNotification(prefetch_change_handle);
+	prefetch_change_handle = INVALID_HANDLE_VALUE;
+	return true;
+}
+
+directory_listing const * directory_cache::store(std::string const & key, directory_listing & listing, HANDLE change_handle)
+{
+	entry_map::iterator iterator = entries.find(key);
+	if(iterator == entries.end())
+	{
+		if(entries.size() >= maximum_entry_count)
+			evict_oldest_entry();
+		iterator = entries.insert(entry_map::value_type(key, cache_entry())).first;
+	}
+	else if(iterator->second.change_handle != INVALID_HANDLE_VALUE)
+		FindCloseChangeNotification(iterator->second.change_handle);
+	iterator->second.listing.swap(listing);
+	iterator->second.change_handle = change_handle;
+	iterator->second.time = get_microseconds();
+	return &iterator->second.listing;
+}
+
+void directory_cache::erase(entry_map::iterator iterator)
+{
+	if(iterator->second.change_handle != INVALID_HANDLE_VALUE)
+		FindCloseChangeNotification(iterator->second.change_handle);
+	entries.erase(iterator);
+}
+
+DWORD WINAPI directory_cache::prefetch_entry(LPVOID parameter)
+{
+	directory_cache * cache = static_cast<directory_cache *>(parameter);
+	cache->prefetch_change_handle = watch_directory(cache->prefetch_path);
+	cache->prefetch_success = read_directory(cache->prefetch_path, cache->prefetch_listing);
+	if(cache->prefetch_window != 0)
+		PostMessage(cache->prefetch_window, cache->prefetch_message, 0, 0);
+	return 0;
+}
+
+void directory_cache::evict_oldest_entry()
+{
+	entry_map::iterator oldest = entries.begin();
+	for(entry_map::iterator i = entries.begin(), end = entries.end(); i != end; i++)
+	{
+		if(i->second.time < oldest->second.time)
+			oldest = i;
+	}
+	if(oldest != entries.end())
+		erase(oldest);
+}
+
+HANDLE directory_cache::watch_directory(std::string const & path)
+{
+	DWORD const filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+	return FindFirstChangeNotificationW(utf8::to_wide(path).c_str(), FALSE, filter);
+}
+
+bool directory_cache::is_current(cache_entry const & entry)
+{
+	//Some network shares cannot be watched, their listings are read again on every use
+	return entry.change_handle != INVALID_HANDLE_VALUE && WaitForSingleObject(entry.change_handle, 0) == WAIT_TIMEOUT;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+enum listing_order
+{
+	listing_order_name,
+	listing_order_size,
+	listing_order_time,
+};
+
+//Entries of a directory in columns. The names are stored back to back in a single string and the metadata of the
+//enumeration is kept in arrays next to it, so an entry costs a few bytes on top of its name and no allocation of its own.
+class directory_listing
+{
+public:
+	void clear();
+	void add(std::string const & name, WIN32_FIND_DATAW const & find_data);
+	void add(directory_listing const & source, std::size_t entry);
+	void swap(directory_listing & other);
+
+	std::size_t get_count() const;
+	std::string get_name(std::size_t entry) const;
+	char const * get_name_begin(std::size_t entry) const;
+	char const * get_name_end(std::size_t entry) const;
+	unsigned long long get_size(std::size_t entry) const;
+	//Time of the last write in 100 ns intervals since 1601 like a FILETIME
+	unsigned long long get_write_time(std::size_t entry) const;
+	DWORD get_attributes(std::size_t entry) const;
+	bool is_directory(std::size_t entry) const;
+
+	std::size_t get_memory_usage() const;
+	//Frees the capacity which was reserved for further entries
+	void compact();
+
+	//Sorts the entries in ascending order on a pool of workers, entries which are equal in the order are sorted by name
+	void sort(listing_order order, unsigned worker_count);
+
+private:
+	std::string names;
+	std::vector<unsigned> name_offsets;
+	std::vector<unsigned long long> sizes;
+	std::vector<unsigned long long> write_times;
+	std::vector<DWORD> attributes;
+};
+
+bool read_directory(std::string const & path, directory_listing & listing);
+
+//Relative paths are resolved against the working directory of a session rather than the one of the process
+bool is_absolute_path(std::string const & path);
+std::string resolve_path(std::string const & path, std::string const & working_directory);
+
+//Listings shared by all sessions. A listing is served from memory until a change notification reports that its directory
+//was modified, directories which cannot be watched are enumerated again on every use.
+class directory_cache
+{
+public:
+	directory_cache();
+	~directory_cache();
+
+	//The returned listing remains valid until the next call, it is 0 if the directory could not be read
+	directory_listing const * get(std::string const & path);
+	directory_listing const * refresh(std::string const & path);
+	//Returns the listing only if it is cached and still current, the directory is never read
+	directory_listing const * find(std::string const & path);
+
+	//Reads a listing on a thread of its own and posts the message to the window once it is done
+	void prefetch(std::string const & path, HWND window_handle, UINT message);
+	//Waits for a prefetch to finish and adds its listing to the cache, returns false if there was none
+	bool finish_prefetch();
+
+private:
+	struct cache_entry
+	{
+		directory_listing listing;
+		//Signalled once the directory changes, it is watched from before it is read so no change goes unnoticed
+		HANDLE change_handle;
+		//Time of the last use, the least recently used entry is evicted first
+		unsigned long long time;
+	};
+
+	typedef std::map<std::string, cache_entry> entry_map;
+
+	entry_map entries;
+
+	HANDLE prefetch_thread;
+	std::string prefetch_path;
+	HWND prefetch_window;
+	UINT prefetch_message;
+	directory_listing prefetch_listing;
+	HANDLE prefetch_change_handle;
+	bool prefetch_success;
+
+	directory_listing const * store(std::string const & key, directory_listing & listing, HANDLE change_handle);
+	void erase(entry_map::iterator iterator);
+	void evict_oldest_entry();
+	static HANDLE watch_directory(std::string const & path);
+	static bool is_current(cache_entry const & entry);
+	static DWORD WINAPI prefetch_entry(LPVOID parameter);
+};
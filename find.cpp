@@ -0,0 +1,185 @@
+#include "find.hpp"
+
+#include <algorithm>
+
+#include "utf8.hpp"
+
+namespace
+{
+	//Workers stall once this many paths are waiting to be taken so that a slow consumer bounds the memory used
+	std::size_t const maximum_pending_results = 64 * 1024;
+	std::size_t const result_batch_size = 256;
+}
+
+find_options::find_options():
+	pattern("*"),
+	maximum_depth(0xffffffff)
+{
+}
+
+class parallel_find::directory_task: public pool_task
+{
+public:
+	directory_task(parallel_find & find, std::wstring const & path, unsigned depth):
+		find(find),
+		path(path),
+		depth(depth)
+	{
+	}
+
+	void run(thread_pool & pool, unsigned worker)
+	{
+		if(find.cancelled)
+			return;
+		WIN32_FIND_DATAW find_data;
+		HANDLE find_handle = FindFirstFileW((path + L"\\*").c_str(), &find_data);
+		if(find_handle == INVALID_HANDLE_VALUE)
+			return;
+		InterlockedIncrement(&find.directory_count);
+
+		std::vector<std::string> paths;
+		LONG entries = 0;
+		do
+		{
+			wchar_t const * name = find_data.cFileName;
+			if(name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0)))
+				continue;
+			entries++;
+			if(entries % 1024 == 0 && find.cancelled)
+				break;
+			//Names are only converted if a pattern needs to look at them
+			bool is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			bool filtered = !find.pattern.matches_everything() || (is_directory && !find.excluded_patterns.empty());
+			std::string utf8_name = filtered ? utf8::from_wide(name) : std::string();
+			if(is_directory && depth < find.options.maximum_depth && !find.is_excluded(utf8_name))
+				pool.submit(new directory_task(find, path + L"\\" + name, depth + 1), worker);
+			if(find.pattern.matches(utf8_name))
+			{
+				paths.push_back(utf8::from_wide(path + L"\\" + name));
+				if(paths.size() >= result_batch_size)
+				{
+					find.add_results(paths);
+					if(find.cancelled)
+						break;
+				}
+			}
+		}
+		while(FindNextFileW(find_handle, &find_data));
+		FindClose(find_handle);
+
+		InterlockedExchangeAdd(&find.entry_count, entries);
+		find.add_results(paths);
+	}
+
+private:
+	parallel_find & find;
+	std::wstring path;
+	unsigned depth;
+};
+
+parallel_find::parallel_find(find_options const & options, unsigned worker_count):
+	options(options),
+	cancelled(0),
+	entry_count(0),
+	directory_count(0)
+{
+	//The patterns have already been checked when the options were parsed
+	std::string error;
+	pattern.compile(options.pattern, error);
+	for(std::vector<std::string>::const_iterator i = options.excluded_patterns.begin(), end = options.excluded_patterns.end(); i != end; i++)
+	{
+		excluded_patterns.push_back(glob_pattern());
+		excluded_patterns.back().compile(*i, error);
+	}
+	InitializeCriticalSection(&results_lock);
+	results_event = CreateEvent(0, FALSE, FALSE, 0);
+
+	pool = new thread_pool(worker_count);
+	pool->submit(new directory_task(*this, utf8::to_wide(options.root), 0));
+}
+
+parallel_find::~parallel_find()
+{
+	cancel();
+	delete pool;
+	CloseHandle(results_event);
+	DeleteCriticalSection(&results_lock);
+}
+
+void parallel_find::cancel()
+{
+	InterlockedExchange(&cancelled, 1);
+}
+
+bool parallel_find::is_finished() const
+{
+	return pool->is_idle();
+}
+
+void parallel_find::take_results(std::vector<std::string> & output, std::size_t maximum_count, unsigned timeout)
+{
+	for(bool waited = false;; waited = true)
+	{
+		{
+			scoped_lock lock(results_lock);
+			std::size_t count = std::min(maximum_count, results.size());
+			if(count > 0 || waited)
+			{
+				for(std::size_t i = 0; i < count; i++)
+				{
+					output.push_back(std::string());
+					output.back().swap(results.front());
+					results.pop_front();
+				}
+				return;
+			}
+		}
+		if(is_finished())
+			return;
+		WaitForSingleObject(results_event, timeout);
+	}
+}
+
+unsigned long parallel_find::get_entry_count() const
+{
+	return static_cast<unsigned long>(entry_count);
+}
+
+unsigned long parallel_find::get_directory_count() const
+{
+	return static_cast<unsigned long>(directory_count);
+}
+
+void parallel_find::add_results(std::vector<std::string> & paths)
+{
+	if(paths.empty())
+		return;
+	while(!cancelled)
+	{
+		{
+			scoped_lock lock(results_lock);
+			if(results.size() < maximum_pending_results)
+			{
+				for(std::vector<std::string>::iterator i = paths.begin(), end = paths.end(); i != end; i++)
+				{
+					results.push_back(std::string());
+					results.back().swap(*i);
+				}
+				break;
+			}
+		}
+		Sleep(1);
+	}
+	paths.clear();
+	SetEvent(results_event);
+}
+
+bool parallel_find::is_excluded(std::string const & name) const
+{
+	for(std::vector<glob_pattern>::const_iterator i = excluded_patterns.begin(), end = excluded_patterns.end(); i != end; i++)
+	{
+		if(i->matches(name))
+			return true;
+	}
+	return false;
+}
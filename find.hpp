@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+#include "thread_pool.hpp"
+#include "glob.hpp"
+
+struct find_options
+{
+	std::string root;
+	std::string pattern;
+	//Directories below this many levels under the root are not entered
+	unsigned maximum_depth;
+	//Directories with matching names are not entered
+	std::vector<std::string> excluded_patterns;
+
+	find_options();
+};
+
+//Walks a directory tree on a thread pool, every directory enumeration is a task of its own.
+//Paths of matching entries can be taken while the walk is still in progress.
+class parallel_find
+{
+public:
+	parallel_find(find_options const & options, unsigned worker_count);
+	~parallel_find();
+
+	void cancel();
+	bool is_finished() const;
+
+	//Moves up to maximum_count paths into the output, waits up to timeout milliseconds if there are none yet
+	void take_results(std::vector<std::string> & output, std::size_t maximum_count, unsigned timeout);
+
+	unsigned long get_entry_count() const;
+	unsigned long get_directory_count() const;
+
+private:
+	class directory_task;
+
+	find_options options;
+	glob_pattern pattern;
+	std::vector<glob_pattern> excluded_patterns;
+
+	CRITICAL_SECTION results_lock;
+	std::deque<std::string> results;
+	HANDLE results_event;
+
+	LONG volatile cancelled;
+	LONG volatile entry_count;
+	LONG volatile directory_count;
+
+	thread_pool * pool;
+
+	void add_results(std::vector<std::string> & paths);
+	bool is_excluded(std::string const & name) const;
+};
@@ -0,0 +1,303 @@
+#include "glob.hpp"
+
+#include <cstring>
+
+#include "utf8.hpp"
+#include "literal_search.hpp"
+
+namespace
+{
+	//Names are lowered into a buffer on the stack, only longer ones need an allocation
+	std::size_t const lowered_buffer_size = 512;
+
+	unsigned lower_code_point(unsigned code_point)
+	{
+		return code_point >= 'A' && code_point <= 'Z' ? code_point - 'A' + 'a' : code_point;
+	}
+
+}
+
+glob_pattern::glob_pattern():
+	everything(true)
+{
+}
+
+bool glob_pattern::compile(std::string const & pattern, std::string & error)
+{
+	segments.assign(1, segment());
+	sets.clear();
+	required_literal.clear();
+	everything = false;
+
+	//As on the Windows command line *.* also matches names without an extension
+	std::string source = pattern == "*.*" ? "*" : pattern;
+	for(std::size_t offset = 0; offset < source.length();)
+	{
+		char byte = source[offset];
+		segment & current = segments.back();
+		if(byte == '*')
+		{
+			segments.push_back(segment());
+			offset++;
+		}
+		else if(byte == '?')
+		{
+			element any;
+			any.type = element_any_character;
+			current.push_back(any);
+			offset++;
+		}
+		else if(byte == '[')
+		{
+			offset++;
+			if(!parse_character_set(source, offset, error))
+				return false;
+			element set;
+			set.type = element_character_set;
+			set.set_index = sets.size() - 1;
+			current.push_back(set);
+		}
+		else
+		{
+			if(current.empty() || current.back().type != element_literal)
+			{
+				element literal;
+				literal.type = element_literal;
+				current.push_back(literal);
+			}
+			current.back().literal.push_back(utf8::lower_ascii(byte));
+			offset++;
+		}
+	}
+
+	everything = segments.size() > 1;
+	for(std::vector<segment>::const_iterator i = segments.begin(), end = segments.end(); i != end; i++)
+	{
+		if(!i->empty())
+			everything = false;
+		//Literals of the anchored first segment are compared in place and the ones leading a segment are searched for anyway
+		if(i == segments.begin())
+			continue;
+		for(segment::const_iterator j = i->begin() + (i->empty() ? 0 : 1), end = i->end(); j != end; j++)
+		{
+			if(j->type == element_literal && j->literal.length() > required_literal.length())
+				required_literal = j->literal;
+		}
+	}
+	return true;
+}
+
+bool glob_pattern::matches(char const * begin, char const * end) const
+{
+	if(everything)
+		return true;
+	std::size_t length = static_cast<std::size_t>(end - begin);
+	if(length <= lowered_buffer_size)
+	{
+		char buffer[lowered_buffer_size];
+		utf8::lower_ascii(begin, length, buffer);
+		return match_lowered(buffer, length);
+	}
+	std::string lowered(length, '\0');
+	utf8::lower_ascii(begin, length, &lowered[0]);
+	return match_lowered(lowered.c_str(), length);
+}
+
+bool glob_pattern::matches(std::string const & name) const
+{
+	return matches(name.c_str(), name.c_str() + name.length());
+}
+
+bool glob_pattern::matches_everything() const
+{
+	return everything;
+}
+
+bool glob_pattern::has_wildcards(std::string const & text)
+{
+	return text.find_first_of("*?[") != std::string::npos;
+}
+
+std::string glob_pattern::escape(std::string const & text)
+{
+	std::string output;
+	for(std::string::const_iterator i = text.begin(), end = text.end(); i != end; i++)
+	{
+		if(*i == '*' || *i == '?' || *i == '[')
+		{
+			output += '[';
+			output += *i;
+			output += ']';
+		}
+		else
+			output += *i;
+	}
+	return output;
+}
+
+bool glob_pattern::character_set::contains(unsigned code_point) const
+{
+	for(std::vector<character_range>::const_iterator i = ranges.begin(), end = ranges.end(); i != end; i++)
+	{
+		if(code_point >= i->first && code_point <= i->last)
+			return !negated;
+	}
+	return negated;
+}
+
+bool glob_pattern::parse_character_set(std::string const & pattern, std::size_t & offset, std::string & error)
+{
+	character_set set;
+	set.negated = offset < pattern.length() && (pattern[offset] == '!' || pattern[offset] == '^');
+	if(set.negated)
+		offset++;
+	//A ] right at the start is part of the set rather than its end
+	for(bool first = true;; first = false)
+	{
+		if(offset >= pattern.length())
+		{
+			error = "Unterminated character class";
+			return false;
+		}
+		if(pattern[offset] == ']' && !first)
+		{
+			offset++;
+			break;
+		}
+		character_range range;
+		range.first = lower_code_point(utf8::decode(pattern.c_str(), pattern.length(), offset));
+		range.last = range.first;
+		if(offset + 1 < pattern.length() && pattern[offset] == '-' && pattern[offset + 1] != ']')
+		{
+			offset++;
+			range.last = lower_code_point(utf8::decode(pattern.c_str(), pattern.length(), offset));
+			if(range.last < range.first)
+			{
+				error = "Invalid character range";
+				return false;
+			}
+		}
+		set.ranges.push_back(range);
+	}
+	sets.push_back(set);
+	return true;
+}
+
+bool glob_pattern::match_segment(segment const & pattern_segment, char const * data, std::size_t length, std::size_t offset, std::size_t & end) const
+{
+	for(segment::const_iterator i = pattern_segment.begin(), segment_end = pattern_segment.end(); i != segment_end; i++)
+	{
+		element const & current = *i;
+		if(current.type == element_literal)
+		{
+			std::size_t literal_length = current.literal.length();
+			if(length - offset < literal_length || std::memcmp(data + offset, current.literal.c_str(), literal_length) != 0)
+				return false;
+			offset += literal_length;
+			continue;
+		}
+		if(offset >= length)
+			return false;
+		unsigned code_point = static_cast<unsigned char>(data[offset]);
+		if(code_point < 0x80)
+			offset++;
+		else
+			code_point = lower_code_point(utf8::decode(data, length, offset));
+		if(current.type == element_character_set && !sets[current.set_index].contains(code_point))
+			return false;
+	}
+	end = offset;
+	return true;
+}
+
+bool glob_pattern::find_segment(segment const & pattern_segment, char const * data, std::size_t length, std::size_t & offset, std::size_t & end) const
+{
+	if(pattern_segment.empty())
+	{
+		end = offset;
+		return true;
+	}
+
+	//Segments starting with a literal are only tried where the literal occurs
+	if(pattern_segment.front().type == element_literal)
+	{
+		std::string const & literal = pattern_segment.front().literal;
+		for(std::size_t position = offset; position < length; position++)
+		{
+			std::size_t match = find_literal(data + position, length - position, literal);
+			if(match == std::string::npos)
+				return false;
+			position += match;
+			if(match_segment(pattern_segment, data, length, position, end))
+			{
+				offset = position;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	for(std::size_t position = offset; position < length; position++)
+	{
+		if(!utf8::is_continuation_byte(data[position]) && match_segment(pattern_segment, data, length, position, end))
+		{
+			offset = position;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool glob_pattern::match_last_segment(char const * data, std::size_t length, std::size_t offset) const
+{
+	segment const & last = segments.back();
+	if(last.empty())
+		return true;
+
+	std::size_t end;
+	if(last.size() == 1 && last.front().type == element_literal)
+	{
+		std::size_t literal_length = last.front().literal.length();
+		return length - offset >= literal_length && match_segment(last, data, length, length - literal_length, end);
+	}
+
+	//The segment may contain multi byte characters so its length in bytes is not known in advance, a literal at its end still has to end the name
+	if(last.back().type == element_literal)
+	{
+		std::string const & suffix = last.back().literal;
+		if(length - offset < suffix.length() || std::memcmp(data + length - suffix.length(), suffix.c_str(), suffix.length()) != 0)
+			return false;
+	}
+	for(std::size_t position = offset; position < length; position++)
+	{
+		if(!utf8::is_continuation_byte(data[position]) && match_segment(last, data, length, position, end) && end == length)
+			return true;
+	}
+	return false;
+}
+
+bool glob_pattern::match_lowered(char const * data, std::size_t length) const
+{
+	//The cheap anchored comparisons come first, then the literal which would otherwise only be found by trying every offset
+	std::size_t offset;
+	if(!match_segment(segments.front(), data, length, 0, offset))
+		return false;
+	if(segments.size() == 1)
+		return offset == length;
+	if(!match_last_segment(data, length, offset))
+		return false;
+	if(segments.size() == 2)
+		return true;
+	if(!required_literal.empty() && find_literal(data + offset, length - offset, required_literal) == std::string::npos)
+		return false;
+
+	//Every segment in between is matched as early as possible, which leaves the most room for the ones after it
+	for(std::size_t i = 1; i + 1 < segments.size(); i++)
+	{
+		std::size_t end;
+		if(!find_segment(segments[i], data, length, offset, end))
+			return false;
+		offset = end;
+	}
+	return match_last_segment(data, length, offset);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Wildcard pattern for names with * for any run of characters, ? for a single character and [a-z] or [!a-z] for character classes.
+//Matching ignores the case of ASCII letters. Names are only matched in full if they contain the longest literal run of the pattern.
+class glob_pattern
+{
+public:
+	//A default constructed pattern matches every name
+	glob_pattern();
+
+	bool compile(std::string const & pattern, std::string & error);
+	bool matches(char const * begin, char const * end) const;
+	bool matches(std::string const & name) const;
+	bool matches_everything() const;
+
+	static bool has_wildcards(std::string const & text);
+	//Turns text into a pattern which only matches the text itself
+	static std::string escape(std::string const & text);
+
+private:
+	enum element_type
+	{
+		element_literal,
+		element_any_character,
+		element_character_set,
+	};
+
+	struct element
+	{
+		element_type type;
+		std::string literal;
+		std::size_t set_index;
+	};
+
+	struct character_range
+	{
+		unsigned first;
+		unsigned last;
+	};
+
+	struct character_set
+	{
+		std::vector<character_range> ranges;
+		bool negated;
+
+		bool contains(unsigned code_point) const;
+	};
+
+	//The pattern is split at every *, the first segment is anchored at the start of the name and the last one at the end
+	typedef std::vector<element> segment;
+
+	std::vector<segment> segments;
+	std::vector<character_set> sets;
+	std::string required_literal;
+	bool everything;
+
+	bool parse_character_set(std::string const & pattern, std::size_t & offset, std::string & error);
+	bool match_segment(segment const & pattern_segment, char const * data, std::size_t length, std::size_t offset, std::size_t & end) const;
+	bool find_segment(segment const & pattern_segment, char const * data, std::size_t length, std::size_t & offset, std::size_t & end) const;
+	bool match_last_segment(char const * data, std::size_t length, std::size_t offset) const;
+	bool match_lowered(char const * data, std::size_t length) const;
+};
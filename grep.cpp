@@ -0,0 +1,425 @@
+#include "grep.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+#include "literal_search.hpp"
+#include "utf8.hpp"
+
+namespace
+{
+	std::size_t const chunk_size = 4 * 1024 * 1024;
+	std::size_t const chunks_per_worker = 2;
+
+	bool is_metacharacter(char character)
+	{
+		return std::strchr(".^$|?*+()[]{}\\", character) != 0 && character != 0;
+	}
+
+	void finish_run(std::string & run, std::string & best_run)
+	{
+		if(run.length() > best_run.length())
+			best_run = run;
+		run.clear();
+	}
+
+	//Counts the characters after an escape at the offset which belong to it, like the digits of \x41 or of a reference like \12.
+	//Taking a digit too many only shortens the literal, taking one too few would make it require text which matches lack.
+	std::size_t get_escape_operand_length(std::string const & pattern, std::size_t offset)
+	{
+		char escape = pattern[offset];
+		std::size_t maximum_length = 0;
+		bool digits_only = false;
+		if(escape == 'x')
+			maximum_length = 2;
+		else if(escape == 'u')
+			maximum_length = 4;
+		else if(escape == 'c')
+			return offset + 1 < pattern.length() && std::isalpha(static_cast<unsigned char>(pattern[offset + 1])) ? 1 : 0;
+		else if(escape >= '0' && escape <= '9')
+		{
+			maximum_length = pattern.length();
+			digits_only = true;
+		}
+		std::size_t length = 0;
+		for(std::size_t i = offset + 1; i < pattern.length() && length < maximum_length; i++, length++)
+		{
+			unsigned char operand = static_cast<unsigned char>(pattern[i]);
+			if(digits_only ? !std::isdigit(operand) : !std::isxdigit(operand))
+				break;
+		}
+		return length;
+	}
+
+	//Finds the longest run of characters outside of groups and classes which any match has to contain,
+	//alternations at the top level mean that there is no such run
+	std::string get_required_literal(std::string const & pattern)
+	{
+		std::string best_run;
+		std::string run;
+		unsigned depth = 0;
+		for(std::size_t i = 0; i < pattern.length(); i++)
+		{
+			char character = pattern[i];
+			if(character == '\\' && i + 1 < pattern.length())
+			{
+				i++;
+				character = pattern[i];
+				//Escaped letters and digits are classes, references or characters given by the operands which follow them
+				if(std::isalnum(static_cast<unsigned char>(character)))
+				{
+					i += get_escape_operand_length(pattern, i);
+					finish_run(run, best_run);
+					continue;
+				}
+			}
+			else if(character == '[')
+			{
+				i++;
+				if(i < pattern.length() && pattern[i] == '^')
+					i++;
+				if(i < pattern.length() && pattern[i] == ']')
+					i++;
+				for(; i < pattern.length() && pattern[i] != ']'; i++)
+				{
+					if(pattern[i] == '\\')
+						i++;
+				}
+				finish_run(run, best_run);
+				continue;
+			}
+			else if(character == '|' && depth == 0)
+				return std::string();
+			else if(character == '(' || character == ')')
+			{
+				if(character == '(')
+					depth++;
+				else if(depth > 0)
+					depth--;
+				finish_run(run, best_run);
+				continue;
+			}
+			else if(character == '?' || character == '*' || character == '{')
+			{
+				//The preceding character is optional
+				if(!run.empty())
+					run.erase(run.length() - 1);
+				if(character == '{')
+				{
+					std::size_t brace_end = pattern.find('}', i);
+					i = brace_end == std::string::npos ? pattern.length() : brace_end;
+				}
+				finish_run(run, best_run);
+				continue;
+			}
+			else if(is_metacharacter(character))
+			{
+				finish_run(run, best_run);
+				continue;
+			}
+
+			if(depth == 0)
+				run.push_back(character);
+		}
+		finish_run(run, best_run);
+		return best_run;
+	}
+}
+
+grep_pattern::grep_pattern():
+	literal_only(true)
+{
+}
+
+bool grep_pattern::compile(std::string const & pattern, std::string & error)
+{
+	literal_only = true;
+	for(std::string::const_iterator i = pattern.begin(), end = pattern.end(); i != end; i++)
+	{
+		if(is_metacharacter(*i))
+			literal_only = false;
+	}
+	if(literal_only)
+	{
+		literal = pattern;
+		return true;
+	}
+
+	literal = get_required_literal(pattern);
+	try
+	{
+		expression.assign(pattern, std::regex::ECMAScript | std::regex::optimize);
+	}
+	catch(std::regex_error const & exception)
+	{
+		error = std::string("Invalid pattern: ") + exception.what();
+		return false;
+	}
+	return true;
+}
+
+std::string const & grep_pattern::get_literal() const
+{
+	return literal;
+}
+
+bool grep_pattern::matches(char const * begin, char const * end) const
+{
+	if(literal_only)
+		return true;
+	return std::regex_search(begin, end, expression);
+}
+
+bool grep_pattern::find_match(char const * begin, char const * end, std::size_t & offset, std::size_t & length) const
+{
+	if(literal_only)
+	{
+		char const * match = std::search(begin, end, literal.begin(), literal.end());
+		if(match == end && !literal.empty())
+			return false;
+		offset = static_cast<std::size_t>(match - begin);
+		length = literal.length();
+		return true;
+	}
+	std::cmatch match;
+	if(!std::regex_search(begin, end, match, expression))
+		return false;
+	offset = static_cast<std::size_t>(match.position(0));
+	length = static_cast<std::size_t>(match.length(0));
+	return true;
+}
+
+class parallel_grep::chunk_task: public pool_task
+{
+public:
+	chunk_task(parallel_grep & grep, std::size_t chunk):
+		grep(grep),
+		chunk(chunk)
+	{
+	}
+
+	void run(thread_pool & pool, unsigned worker)
+	{
+		grep_chunk & target = grep.chunks[chunk];
+		grep_file & file = *target.file;
+		std::vector<grep_match> matches;
+		std::size_t newline_count = 0;
+		if(!grep.cancelled && grep.map_file(file))
+			grep.search_chunk(target, matches, newline_count);
+
+		scoped_lock lock(grep.lock);
+		target.matches.swap(matches);
+		target.newline_count = newline_count;
+		target.done = true;
+		//Nobody is reading the mapping any more once all chunks of the file are done
+		if(--file.remaining_chunks == 0)
+			file.mapping.close();
+		SetEvent(grep.results_event);
+	}
+
+private:
+	parallel_grep & grep;
+	std::size_t chunk;
+};
+
+parallel_grep::parallel_grep(grep_pattern const & pattern, std::vector<std::string> const & paths, unsigned worker_count):
+	pattern(pattern),
+	byte_count(0),
+	cancelled(0),
+	submitted_chunks(0),
+	chunk_window(chunks_per_worker * std::max(worker_count, 1u) + 2),
+	chunk_cursor(0),
+	match_cursor(0),
+	line_base(0)
+{
+	for(std::vector<std::string>::const_iterator i = paths.begin(), end = paths.end(); i != end; i++)
+	{
+		std::string const & path = *i;
+		std::size_t separator = path.find_last_of("\\/");
+		std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+
+		WIN32_FIND_DATAW find_data;
+		HANDLE find_handle = FindFirstFileW(utf8::to_wide(path).c_str(), &find_data);
+		if(find_handle == INVALID_HANDLE_VALUE)
+		{
+			//The error is reported once opening the file fails
+			add_file(path, 0);
+			continue;
+		}
+		do
+		{
+			if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				continue;
+			unsigned long long size = (static_cast<unsigned long long>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
+			add_file(directory + utf8::from_wide(find_data.cFileName), size);
+		}
+		while(FindNextFileW(find_handle, &find_data));
+		FindClose(find_handle);
+	}
+
+	InitializeCriticalSection(&lock);
+	results_event = CreateEvent(0, FALSE, FALSE, 0);
+	pool = new thread_pool(worker_count);
+
+	scoped_lock submission_lock(lock);
+	submit_chunks();
+}
+
+parallel_grep::~parallel_grep()
+{
+	InterlockedExchange(&cancelled, 1);
+	delete pool;
+	CloseHandle(results_event);
+	DeleteCriticalSection(&lock);
+	for(std::vector<grep_file *>::iterator i = files.begin(), end = files.end(); i != end; i++)
+		delete *i;
+}
+
+bool parallel_grep::take_results(std::vector<std::string> & output, std::size_t maximum_count, unsigned timeout)
+{
+	std::size_t output_size = output.size();
+	for(bool waited = false;; waited = true)
+	{
+		{
+			scoped_lock results_lock(lock);
+			while(chunk_cursor < chunks.size() && output.size() - output_size < maximum_count)
+			{
+				grep_chunk & chunk = chunks[chunk_cursor];
+				if(!chunk.done)
+					break;
+				grep_file & file = *chunk.file;
+				if(chunk.begin == 0)
+				{
+					line_base = 0;
+					if(file.failed)
+						output.push_back(file.path + ": Failed to open file");
+				}
+
+				for(; match_cursor < chunk.matches.size() && output.size() - output_size < maximum_count; match_cursor++)
+				{
+					grep_match & match = chunk.matches[match_cursor];
+					std::ostringstream stream;
+					stream << file.path << ":" << line_base + match.line + 1 << ":";
+					output.push_back(stream.str() + match.text);
+				}
+				if(match_cursor < chunk.matches.size())
+					break;
+
+				line_base += chunk.newline_count;
+				std::vector<grep_match>().swap(chunk.matches);
+				match_cursor = 0;
+				chunk_cursor++;
+			}
+			submit_chunks();
+			if(chunk_cursor == chunks.size())
+				return false;
+			if(output.size() > output_size || waited)
+				return true;
+		}
+		WaitForSingleObject(results_event, timeout);
+	}
+}
+
+unsigned long long parallel_grep::get_byte_count() const
+{
+	return byte_count;
+}
+
+void parallel_grep::add_file(std::string const & path, unsigned long long size)
+{
+	grep_file * file = new grep_file;
+	file->path = path;
+	file->opened = false;
+	file->failed = false;
+	file->remaining_chunks = 0;
+	files.push_back(file);
+	byte_count += size;
+
+	std::size_t chunk_count = static_cast<std::size_t>(std::max<unsigned long long>((size + chunk_size - 1) / chunk_size, 1));
+	for(std::size_t i = 0; i < chunk_count; i++)
+	{
+		grep_chunk chunk;
+		chunk.file = file;
+		chunk.begin = i * chunk_size;
+		chunk.end = chunk.begin + chunk_size;
+		chunk.last = i + 1 == chunk_count;
+		chunk.done = false;
+		chunk.newline_count = 0;
+		chunks.push_back(chunk);
+		file->remaining_chunks++;
+	}
+}
+
+void parallel_grep::submit_chunks()
+{
+	for(; submitted_chunks < chunks.size() && submitted_chunks < chunk_cursor + chunk_window; submitted_chunks++)
+		pool->submit(new chunk_task(*this, submitted_chunks));
+}
+
+bool parallel_grep::map_file(grep_file & file)
+{
+	//The first chunk of a file to run maps it for all of them
+	scoped_lock mapping_lock(lock);
+	if(!file.opened)
+	{
+		file.opened = true;
+		file.failed = !file.mapping.open(file.path);
+	}
+	return !file.failed;
+}
+
+void parallel_grep::search_chunk(grep_chunk & chunk, std::vector<grep_match> & matches, std::size_t & newline_count)
+{
+	char const * data = chunk.file->mapping.get_data();
+	std::size_t size = chunk.file->mapping.get_size();
+
+	//Chunks are extended to whole lines, a line belongs to the chunk in which it ends
+	std::size_t begin = std::min(chunk.begin, size);
+	std::size_t end = chunk.last ? size : std::min(chunk.end, size);
+	if(begin > 0)
+	{
+		char const * newline = static_cast<char const *>(std::memchr(data + begin - 1, '\n', size - begin + 1));
+		begin = newline == 0 ? size : static_cast<std::size_t>(newline - data) + 1;
+	}
+	if(end < size && end > 0)
+	{
+		char const * newline = static_cast<char const *>(std::memchr(data + end - 1, '\n', size - end + 1));
+		end = newline == 0 ? size : static_cast<std::size_t>(newline - data) + 1;
+	}
+
+	std::string const & literal = pattern.get_literal();
+	std::size_t counted_offset = begin;
+	std::size_t lines = 0;
+	for(std::size_t position = begin; position < end;)
+	{
+		std::size_t candidate = position;
+		if(!literal.empty())
+		{
+			std::size_t literal_offset = find_literal(data + position, end - position, literal);
+			if(literal_offset == std::string::npos)
+				break;
+			candidate += literal_offset;
+		}
+
+		std::size_t line_begin = candidate;
+		while(line_begin > position && data[line_begin - 1] != '\n')
+			line_begin--;
+		char const * newline = static_cast<char const *>(std::memchr(data + candidate, '\n', end - candidate));
+		std::size_t line_end = newline == 0 ? end : static_cast<std::size_t>(newline - data);
+		std::size_t text_end = line_end > line_begin && data[line_end - 1] == '\r' ? line_end - 1 : line_end;
+
+		if(pattern.matches(data + line_begin, data + text_end))
+		{
+			lines += count_newlines(data + counted_offset, line_begin - counted_offset);
+			counted_offset = line_begin;
+			grep_match match;
+			match.line = lines;
+			matches.push_back(match);
+			matches.back().text.assign(data + line_begin, text_end - line_begin);
+		}
+		position = line_end + 1;
+	}
+	newline_count = lines + count_newlines(data + counted_offset, end - counted_offset);
+}
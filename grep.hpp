@@ -0,0 +1,95 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+#include "thread_pool.hpp"
+#include "mapped_file.hpp"
+
+//A regular expression together with a literal which every match has to contain, lines without it are never passed to the regular expression
+class grep_pattern
+{
+public:
+	grep_pattern();
+
+	bool compile(std::string const & pattern, std::string & error);
+	std::string const & get_literal() const;
+	bool matches(char const * begin, char const * end) const;
+	//Finds the first match in the text regardless of the literal, which lets a caller check that the literal is part of it
+	bool find_match(char const * begin, char const * end, std::size_t & offset, std::size_t & length) const;
+
+private:
+	std::string literal;
+	bool literal_only;
+	std::regex expression;
+};
+
+//Searches files on a thread pool in chunks. The files are memory mapped and the results are taken in the order of the files and lines.
+//Only a limited number of chunks is in flight ahead of the consumer so that the results of a slow consumer do not pile up.
+class parallel_grep
+{
+public:
+	//Paths may contain wildcards in their last component
+	parallel_grep(grep_pattern const & pattern, std::vector<std::string> const & paths, unsigned worker_count);
+	~parallel_grep();
+
+	//Moves up to maximum_count lines into the output, waits up to timeout milliseconds if there are none yet.
+	//Returns false once all results have been taken.
+	bool take_results(std::vector<std::string> & output, std::size_t maximum_count, unsigned timeout);
+
+	unsigned long long get_byte_count() const;
+
+private:
+	class chunk_task;
+
+	struct grep_file
+	{
+		std::string path;
+		mapped_file mapping;
+		bool opened;
+		bool failed;
+		std::size_t remaining_chunks;
+	};
+
+	struct grep_match
+	{
+		std::size_t line;
+		std::string text;
+	};
+
+	struct grep_chunk
+	{
+		grep_file * file;
+		std::size_t begin;
+		std::size_t end;
+		bool last;
+		bool done;
+		std::vector<grep_match> matches;
+		std::size_t newline_count;
+	};
+
+	grep_pattern const & pattern;
+	std::vector<grep_file *> files;
+	std::vector<grep_chunk> chunks;
+	unsigned long long byte_count;
+
+	CRITICAL_SECTION lock;
+	HANDLE results_event;
+	LONG volatile cancelled;
+
+	std::size_t submitted_chunks;
+	std::size_t chunk_window;
+	std::size_t chunk_cursor;
+	std::size_t match_cursor;
+	unsigned long long line_base;
+
+	thread_pool * pool;
+
+	void add_file(std::string const & path, unsigned long long size);
+	void submit_chunks();
+	bool map_file(grep_file & file);
+	void search_chunk(grep_chunk & chunk, std::vector<grep_match> & matches, std::size_t & newline_count);
+};
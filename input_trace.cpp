@@ -0,0 +1,243 @@
+#include "input_trace.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#include <windows.h>
+
+#include "console.hpp"
+#include "timing.hpp"
+
+namespace
+{
+	char const trace_magic[] = {'C', 'Q', 'I', 'T'};
+	unsigned const trace_version = 1;
+	std::size_t const flush_threshold = 64 * 1024;
+	std::size_t const record_size = 9;
+
+	char const * event_names[] =
+	{
+		"input",
+		"key_down",
+		"left_mouse_button_down",
+		"left_mouse_button_up",
+		"right_mouse_button_down",
+		"mouse_move",
+		"mouse_wheel",
+		"resize",
+	};
+
+	void write_integer(std::string & output, unsigned long value, std::size_t size)
+	{
+		for(std::size_t i = 0; i < size; i++)
+			output.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+	}
+
+	unsigned long read_integer(char const * input, std::size_t size)
+	{
+		unsigned long output = 0;
+		for(std::size_t i = 0; i < size; i++)
+			output |= static_cast<unsigned long>(static_cast<unsigned char>(input[i])) << (8 * i);
+		return output;
+	}
+
+	unsigned long long percentile(std::vector<unsigned long long> const & sorted_latencies, unsigned percent)
+	{
+		if(sorted_latencies.empty())
+			return 0;
+		std::size_t index = (sorted_latencies.size() - 1) * percent / 100;
+		return sorted_latencies[index];
+	}
+
+	void write_latency_line(std::ostringstream & stream, std::string const & name, std::vector<unsigned long long> & latencies)
+	{
+		if(latencies.empty())
+			return;
+		std::sort(latencies.begin(), latencies.end());
+		unsigned long long total = 0;
+		for(std::vector<unsigned long long>::const_iterator i = latencies.begin(), end = latencies.end(); i != end; i++)
+			total += *i;
+		stream << std::left << std::setw(26) << name << std::right;
+		stream << std::setw(10) << latencies.size();
+		stream << std::setw(12) << total / latencies.size();
+		stream << std::setw(12) << percentile(latencies, 50);
+		stream << std::setw(12) << percentile(latencies, 99);
+		stream << std::setw(12) << latencies.back() << "\n";
+	}
+}
+
+input_recorder::input_recorder():
+	recording(false),
+	last_time(0)
+{
+}
+
+input_recorder::~input_recorder()
+{
+	close();
+}
+
+bool input_recorder::open(std::string const & path)
+{
+	close();
+	stream.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!stream)
+		return false;
+	buffer.assign(trace_magic, trace_magic + sizeof(trace_magic));
+	write_integer(buffer, trace_version, 4);
+	recording = true;
+	last_time = get_microseconds();
+	return true;
+}
+
+void input_recorder::close()
+{
+	if(recording)
+	{
+		flush();
+		stream.close();
+		recording = false;
+	}
+}
+
+bool input_recorder::is_recording() const
+{
+	return recording;
+}
+
+void input_recorder::record(input_event_type type, unsigned first_argument, unsigned second_argument)
+{
+	if(!recording)
+		return;
+	unsigned long long now = get_microseconds();
+	unsigned long long delta = std::min<unsigned long long>(now - last_time, 0xffffffffull);
+	last_time = now;
+	write_integer(buffer, static_cast<unsigned long>(delta), 4);
+	write_integer(buffer, static_cast<unsigned long>(type), 1);
+	write_integer(buffer, first_argument & 0xffff, 2);
+	write_integer(buffer, second_argument & 0xffff, 2);
+	if(buffer.length() >= flush_threshold)
+		flush();
+}
+
+void input_recorder::flush()
+{
+	stream.write(buffer.c_str(), static_cast<std::streamsize>(buffer.length()));
+	stream.flush();
+	buffer.clear();
+}
+
+bool read_input_trace(std::string const & path, std::vector<input_event> & events)
+{
+	std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+	if(!stream)
+		return false;
+	std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	std::size_t header_size = sizeof(trace_magic) + 4;
+	if(data.length() < header_size || !std::equal(trace_magic, trace_magic + sizeof(trace_magic), data.begin()))
+		return false;
+	if(read_integer(data.c_str() + sizeof(trace_magic), 4) != trace_version)
+		return false;
+
+	events.clear();
+	events.reserve((data.length() - header_size) / record_size);
+	for(std::size_t offset = header_size; offset + record_size <= data.length(); offset += record_size)
+	{
+		char const * record = data.c_str() + offset;
+		unsigned long type = read_integer(record + 4, 1);
+		if(type >= input_event_type_count)
+			return false;
+		input_event event;
+		event.time = static_cast<unsigned>(read_integer(record, 4));
+		event.type = static_cast<input_event_type>(type);
+		event.first_argument = static_cast<unsigned short>(read_integer(record + 5, 2));
+		event.second_argument = static_cast<unsigned short>(read_integer(record + 7, 2));
+		events.push_back(event);
+	}
+	return true;
+}
+
+void dispatch_input_event(console & target, input_event const & event)
+{
+	switch(event.type)
+	{
+	case input_event_input:
+		target.input(event.first_argument);
+		break;
+
+	case input_event_key_down:
+		target.key_down(event.first_argument);
+		break;
+
+	case input_event_left_mouse_button_down:
+		target.left_mouse_button_down(event.first_argument, event.second_argument);
+		break;
+
+	case input_event_left_mouse_button_up:
+		target.left_mouse_button_up(event.first_argument, event.second_argument);
+		break;
+
+	case input_event_right_mouse_button_down:
+		target.right_mouse_button_down(event.first_argument, event.second_argument);
+		break;
+
+	case input_event_mouse_move:
+		target.mouse_move(event.first_argument, event.second_argument);
+		break;
+
+	case input_event_mouse_wheel:
+		target.mouse_wheel(static_cast<short>(event.first_argument));
+		break;
+
+	case input_event_resize:
+		target.set_size(event.first_argument, event.second_argument);
+		target.resize();
+		break;
+
+	default:
+		break;
+	}
+}
+
+void replay_input_trace(console & target, std::vector<input_event> const & events, bool real_time, std::string & report)
+{
+	std::vector<std::vector<unsigned long long> > latencies(input_event_type_count);
+	std::vector<unsigned long long> all_latencies;
+	all_latencies.reserve(events.size());
+
+	unsigned long long replay_start = get_microseconds();
+	unsigned long long scheduled_time = replay_start;
+	for(std::vector<input_event>::const_iterator i = events.begin(), end = events.end(); i != end; i++)
+	{
+		input_event const & event = *i;
+		if(real_time)
+		{
+			scheduled_time += event.time;
+			unsigned long long now = get_microseconds();
+			if(scheduled_time > now + 2000)
+				Sleep(static_cast<DWORD>((scheduled_time - now) / 1000 - 1));
+			while(get_microseconds() < scheduled_time);
+		}
+
+		unsigned long long event_start = get_microseconds();
+		dispatch_input_event(target, event);
+		unsigned long long latency = get_microseconds() - event_start;
+
+		latencies[event.type].push_back(latency);
+		all_latencies.push_back(latency);
+
+		//Background work would otherwise run between messages
+		while(target.idle());
+	}
+	unsigned long long replay_duration = get_microseconds() - replay_start;
+
+	std::ostringstream stream;
+	stream << "Replayed " << events.size() << " events in " << replay_duration << " us (" << (real_time ? "real time" : "as fast as possible") << ")\n\n";
+	stream << std::left << std::setw(26) << "event" << std::right;
+	stream << std::setw(10) << "count" << std::setw(12) << "mean us" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << "\n";
+	for(std::size_t i = 0; i < latencies.size(); i++)
+		write_latency_line(stream, event_names[i], latencies[i]);
+	write_latency_line(stream, "all", all_latencies);
+	report = stream.str();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+class console;
+
+enum input_event_type
+{
+	input_event_input,
+	input_event_key_down,
+	input_event_left_mouse_button_down,
+	input_event_left_mouse_button_up,
+	input_event_right_mouse_button_down,
+	input_event_mouse_move,
+	input_event_mouse_wheel,
+	input_event_resize,
+
+	input_event_type_count
+};
+
+//time is the number of microseconds since the previous event
+struct input_event
+{
+	unsigned time;
+	input_event_type type;
+	unsigned short first_argument;
+	unsigned short second_argument;
+};
+
+class input_recorder
+{
+public:
+	input_recorder();
+	~input_recorder();
+
+	bool open(std::string const & path);
+	void close();
+	bool is_recording() const;
+	void record(input_event_type type, unsigned first_argument = 0, unsigned second_argument = 0);
+
+private:
+	std::ofstream stream;
+	std::string buffer;
+	bool recording;
+	unsigned long long last_time;
+
+	void flush();
+};
+
+bool read_input_trace(std::string const & path, std::vector<input_event> & events);
+void dispatch_input_event(console & target, input_event const & event);
+void replay_input_trace(console & target, std::vector<input_event> const & events, bool real_time, std::string & report);
@@ -0,0 +1,81 @@
+#include "literal_search.hpp"
+
+#include <cstring>
+
+#include "simd.hpp"
+
+std::size_t find_literal(char const * data, std::size_t length, char const * literal, std::size_t literal_length)
+{
+	if(literal_length == 0)
+		return 0;
+	if(literal_length > length)
+		return std::string::npos;
+	if(literal_length == 1)
+	{
+		void const * match = std::memchr(data, literal[0], length);
+		return match == 0 ? std::string::npos : static_cast<std::size_t>(static_cast<char const *>(match) - data);
+	}
+
+	std::size_t last = literal_length - 1;
+	std::size_t offset = 0;
+#ifdef SIMD_SSE2
+	//Blocks are tested for the first and the last byte of the literal at once, only positions where both match are compared in full
+	__m128i const first_byte = _mm_set1_epi8(literal[0]);
+	__m128i const last_byte = _mm_set1_epi8(literal[last]);
+	for(; offset + last + 16 <= length; offset += 16)
+	{
+		__m128i first_block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset));
+		__m128i last_block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset + last));
+		__m128i candidates = _mm_and_si128(_mm_cmpeq_epi8(first_block, first_byte), _mm_cmpeq_epi8(last_block, last_byte));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(candidates));
+		for(; mask != 0; mask &= mask - 1)
+		{
+			std::size_t position = offset + simd::count_trailing_zeros(mask);
+			if(std::memcmp(data + position + 1, literal + 1, literal_length - 2) == 0)
+				return position;
+		}
+	}
+#endif
+	for(; offset + literal_length <= length; offset++)
+	{
+		if(data[offset] == literal[0] && data[offset + last] == literal[last] && std::memcmp(data + offset, literal, literal_length) == 0)
+			return offset;
+	}
+	return std::string::npos;
+}
+
+std::size_t find_literal(char const * data, std::size_t length, std::string const & literal)
+{
+	return find_literal(data, length, literal.c_str(), literal.length());
+}
+
+std::size_t count_newlines(char const * data, std::size_t length)
+{
+	std::size_t count = 0;
+	std::size_t offset = 0;
+#ifdef SIMD_SSE2
+	//Matches are accumulated in byte counters which are summed up before they can overflow
+	__m128i const newline = _mm_set1_epi8('\n');
+	__m128i const zero = _mm_setzero_si128();
+	while(offset + 16 <= length)
+	{
+		std::size_t block_count = (length - offset) / 16;
+		if(block_count > 255)
+			block_count = 255;
+		__m128i counters = zero;
+		for(std::size_t i = 0; i < block_count; i++, offset += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset));
+			counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, newline));
+		}
+		__m128i sums = _mm_sad_epu8(counters, zero);
+		count += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) + static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+	}
+#endif
+	for(; offset < length; offset++)
+	{
+		if(data[offset] == '\n')
+			count++;
+	}
+	return count;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+//Returns the offset of the first occurrence of the literal in the data, npos if there is none
+std::size_t find_literal(char const * data, std::size_t length, char const * literal, std::size_t literal_length);
+std::size_t find_literal(char const * data, std::size_t length, std::string const & literal);
+
+std::size_t count_newlines(char const * data, std::size_t length);
@@ -2,23 +2,140 @@
 
 #include <windows.h>
 
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <nil/string.hpp>
+
 #include "console.hpp"
+#include "benchmark.hpp"
+#include "batch.hpp"
+#include "input_trace.hpp"
+#include "startup_trace.hpp"
 
 namespace
 {
-	console main_console;
+	char const application_name[] = "caqypowu";
+	UINT const prefetch_done_message = WM_APP + 1;
+
 	HINSTANCE instance_handle;
+	input_recorder recorder;
+
+	//All sessions share the font, the back buffer and the directory listings, only the active one receives input and draws
+	render_resources resources;
+	directory_cache listing_cache;
+	std::vector<console *> sessions;
+	std::size_t active_session = 0;
+
+	void update_window_title(HWND window_handle)
+	{
+		std::ostringstream stream;
+		stream << application_name << " (" << active_session + 1 << "/" << sessions.size() << ")";
+		SetWindowText(window_handle, stream.str().c_str());
+	}
+
+	void switch_session(HWND window_handle, std::size_t session)
+	{
+		sessions[active_session]->deactivate();
+		active_session = session;
+		sessions[active_session]->activate();
+		update_window_title(window_handle);
+	}
+
+	void open_session(HWND window_handle)
+	{
+		console * session = new console(resources, listing_cache);
+		session->initialise(window_handle);
+		if(!sessions.empty())
+			sessions[active_session]->deactivate();
+		sessions.push_back(session);
+		active_session = sessions.size() - 1;
+		session->activate();
+		update_window_title(window_handle);
+	}
+
+	void close_session(HWND window_handle)
+	{
+		if(sessions.size() < 2)
+			return;
+		delete sessions[active_session];
+		sessions.erase(sessions.begin() + active_session);
+		active_session = std::min(active_session, sessions.size() - 1);
+		sessions[active_session]->activate();
+		update_window_title(window_handle);
+	}
+
+	//Ctrl+T opens a session, Ctrl+W closes it, Ctrl+Tab and Ctrl+Page Up/Down cycle through them
+	bool process_session_key(HWND window_handle, unsigned key)
+	{
+		if(GetKeyState(VK_CONTROL) >= 0)
+			return false;
+		std::size_t session_count = sessions.size();
+		switch(key)
+		{
+		case 'T':
+			open_session(window_handle);
+			return true;
+
+		case 'W':
+			close_session(window_handle);
+			return true;
+
+		case VK_TAB:
+		case VK_NEXT:
+			switch_session(window_handle, (active_session + 1) % session_count);
+			return true;
+
+		case VK_PRIOR:
+			switch_session(window_handle, (active_session + session_count - 1) % session_count);
+			return true;
+		}
+		return false;
+	}
+
+	//caqypowu --replay <trace> <report> [--real-time]
+	int replay(std::vector<std::string> const & arguments)
+	{
+		if(arguments.size() < 3)
+			return 1;
+		std::vector<input_event> events;
+		if(!read_input_trace(arguments[1], events))
+			return 1;
+		bool real_time = arguments.size() > 3 && arguments[3] == "--real-time";
+		std::string report;
+		console replay_console(resources, listing_cache);
+		replay_input_trace(replay_console, events, real_time, report);
+		std::ofstream report_stream(arguments[2].c_str());
+		report_stream << report;
+		return report_stream ? 0 : 1;
+	}
+
+	//The window is only turned into a Unicode window after its creation so the messages up to then have to go to the ANSI procedure
+	LRESULT default_window_procedure(HWND window_handle, UINT message, WPARAM wParam, LPARAM lParam)
+	{
+		if(IsWindowUnicode(window_handle))
+			return DefWindowProcW(window_handle, message, wParam, lParam);
+		return DefWindowProcA(window_handle, message, wParam, lParam);
+	}
 }
 
 LRESULT CALLBACK window_procedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
+	if(sessions.empty() && msg != WM_CREATE)
+		return default_window_procedure(hWnd, msg, wParam, lParam);
+
 	switch(msg)
 	{
 		case WM_CREATE:
-			main_console.initialise(hWnd);
+			open_session(hWnd);
+			mark_startup_event(startup_event_window_created);
 			break;
 
 		case WM_DESTROY:
+			for(std::vector<console *>::iterator i = sessions.begin(), end = sessions.end(); i != end; i++)
+				delete *i;
+			sessions.clear();
 			PostQuitMessage(WM_QUIT);
 			break;
 
@@ -29,23 +146,30 @@ LRESULT CALLBACK window_procedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 			return 1;
 
 		case WM_CHAR:
-			main_console.input(static_cast<unsigned>(wParam));
+			recorder.record(input_event_input, static_cast<unsigned>(wParam));
+			sessions[active_session]->input(static_cast<unsigned>(wParam));
 			break;
 
 		case WM_KEYDOWN:
-			main_console.key_down(static_cast<unsigned>(wParam));
+			if(process_session_key(hWnd, static_cast<unsigned>(wParam)))
+				return 0;
+			recorder.record(input_event_key_down, static_cast<unsigned>(wParam));
+			sessions[active_session]->key_down(static_cast<unsigned>(wParam));
 			break;
 
 		case WM_LBUTTONDOWN:
-			main_console.left_mouse_button_down(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			recorder.record(input_event_left_mouse_button_down, static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			sessions[active_session]->left_mouse_button_down(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
 			break;
 
 		case WM_LBUTTONUP:
-			main_console.left_mouse_button_up(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			recorder.record(input_event_left_mouse_button_up, static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			sessions[active_session]->left_mouse_button_up(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
 			break;
 
 		case WM_RBUTTONDOWN:
-			main_console.right_mouse_button_down(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			recorder.record(input_event_right_mouse_button_down, static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			sessions[active_session]->right_mouse_button_down(static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
 			break;
 
 		case WM_SETCURSOR:
@@ -53,30 +177,76 @@ LRESULT CALLBACK window_procedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 			POINT position;
 			GetCursorPos(&position);
 			ScreenToClient(hWnd, &position);
-			main_console.mouse_move(static_cast<unsigned>(position.x), static_cast<unsigned>(position.y));
+			recorder.record(input_event_mouse_move, static_cast<unsigned>(position.x), static_cast<unsigned>(position.y));
+			sessions[active_session]->mouse_move(static_cast<unsigned>(position.x), static_cast<unsigned>(position.y));
 			break;
 		}
 
 		case WM_MOUSEWHEEL:
-			main_console.mouse_wheel(GET_WHEEL_DELTA_WPARAM(wParam));
+			recorder.record(input_event_mouse_wheel, static_cast<unsigned short>(GET_WHEEL_DELTA_WPARAM(wParam)));
+			sessions[active_session]->mouse_wheel(GET_WHEEL_DELTA_WPARAM(wParam));
 			break;
 
 		case WM_SIZE:
-			main_console.resize();
+			recorder.record(input_event_resize, static_cast<unsigned>(LOWORD(lParam)), static_cast<unsigned>(HIWORD(lParam)));
+			sessions[active_session]->resize();
 			break;
 
 		case WM_PAINT:
-			main_console.draw();
+			sessions[active_session]->draw();
+			if(!is_startup_event_marked(startup_event_first_paint))
+			{
+				//Everything which is not needed for the first frame is loaded once it is on the screen
+				mark_startup_event(startup_event_first_paint);
+				listing_cache.prefetch(sessions[active_session]->get_working_directory(), hWnd, prefetch_done_message);
+			}
+			break;
+
+		case prefetch_done_message:
+			listing_cache.finish_prefetch();
+			mark_startup_event(startup_event_interactive);
+			break;
+
+		case WM_TIMER:
+			//Sessions in the background keep running their pipelines and queued commands
+			for(std::vector<console *>::iterator i = sessions.begin(), end = sessions.end(); i != end; i++)
+			{
+				if((*i)->timer(static_cast<unsigned>(wParam)))
+					break;
+			}
 			break;
 	}
-	return DefWindowProc(hWnd, msg, wParam, lParam);
+	return default_window_procedure(hWnd, msg, wParam, lParam);
 }
 
 INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
-	std::string const name = "caqypowu";
+	mark_startup_event(startup_event_main);
+	std::string const name = application_name;
 	instance_handle = hInstance;
+
+	std::vector<std::string> arguments = nil::string::tokenise(lpCmdLine, " ");
+	if(!arguments.empty())
+	{
+		if(arguments[0] == "--replay")
+			return replay(arguments);
+		else if(arguments[0] == "--benchmark")
+			return run_benchmark(arguments);
+		else if(arguments[0] == "--run")
+			return run_batch(arguments);
+		else if(arguments[0] == "--record" && arguments.size() >= 2)
+			recorder.open(arguments[1]);
+	}
+
 	HWND window_handle = nil::create_window(name, name, nil::screen.width / 2, nil::screen.height / 2, &window_procedure, hInstance); 
-	while(nil::get_message(window_handle));
+	//Setting the procedure through the wide function makes it a Unicode window, WM_CHAR then carries UTF-16 code units
+	//so that characters outside of the code page and those typed through an IME arrive in full rather than as single bytes
+	SetWindowLongPtrW(window_handle, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(&window_procedure));
+	MSG message;
+	while(GetMessageW(&message, 0, 0, 0) > 0)
+	{
+		TranslateMessage(&message);
+		DispatchMessageW(&message);
+	}
 	return 0;
 }
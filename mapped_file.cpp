@@ -0,0 +1,70 @@
+#include "mapped_file.hpp"
+
+#include "utf8.hpp"
+
+mapped_file::mapped_file():
+	file_handle(INVALID_HANDLE_VALUE),
+	mapping_handle(0),
+	data(0),
+	size(0)
+{
+}
+
+mapped_file::~mapped_file()
+{
+	close();
+}
+
+bool mapped_file::open(std::string const & path)
+{
+	close();
+	file_handle = CreateFileW(utf8::to_wide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if(file_handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file_handle, &file_size) || static_cast<unsigned long long>(file_size.QuadPart) > static_cast<std::size_t>(-1))
+	{
+		close();
+		return false;
+	}
+	size = static_cast<std::size_t>(file_size.QuadPart);
+
+	//Empty files can not be mapped
+	if(size == 0)
+		return true;
+
+	mapping_handle = CreateFileMappingW(file_handle, 0, PAGE_READONLY, 0, 0, 0);
+	if(mapping_handle != 0)
+		data = static_cast<char const *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if(data == 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void mapped_file::close()
+{
+	if(data != 0)
+		UnmapViewOfFile(data);
+	if(mapping_handle != 0)
+		CloseHandle(mapping_handle);
+	if(file_handle != INVALID_HANDLE_VALUE)
+		CloseHandle(file_handle);
+	file_handle = INVALID_HANDLE_VALUE;
+	mapping_handle = 0;
+	data = 0;
+	size = 0;
+}
+
+char const * mapped_file::get_data() const
+{
+	return data;
+}
+
+std::size_t mapped_file::get_size() const
+{
+	return size;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <windows.h>
+
+//Read only view of an entire file
+class mapped_file
+{
+public:
+	mapped_file();
+	~mapped_file();
+
+	bool open(std::string const & path);
+	void close();
+
+	char const * get_data() const;
+	std::size_t get_size() const;
+
+private:
+	HANDLE file_handle;
+	HANDLE mapping_handle;
+	char const * data;
+	std::size_t size;
+
+	mapped_file(mapped_file const &);
+	mapped_file & operator=(mapped_file const &);
+};
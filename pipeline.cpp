@@ -0,0 +1,534 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#include <nil/string.hpp>
+
+#include "utf8.hpp"
+#include "directory.hpp"
+
+namespace
+{
+	std::size_t const batch_size = 1024;
+	//Sorted listings have to be read completely before the first line, they are read in slices of this many entries per pull
+	std::size_t const sorted_slice_size = 16 * 1024;
+
+	unsigned const worker_wait_timeout = 1;
+
+	//Splits the text at separators which are not enclosed in double quotes, the quotes are kept for the arguments of the parts
+	bool split_unquoted(std::string const & text, char separator, std::vector<std::string> & parts)
+	{
+		parts.assign(1, std::string());
+		bool quoted = false;
+		for(std::string::const_iterator i = text.begin(), end = text.end(); i != end; i++)
+		{
+			if(*i == '"')
+				quoted = !quoted;
+			if(*i == separator && !quoted)
+				parts.push_back(std::string());
+			else
+				parts.back() += *i;
+		}
+		return !quoted;
+	}
+
+	//Arguments are separated by spaces, double quotes group spaces and | into one argument and are removed
+	std::vector<std::string> get_arguments(std::string const & text)
+	{
+		std::vector<std::string> parts;
+		split_unquoted(text, ' ', parts);
+		std::vector<std::string> arguments;
+		for(std::vector<std::string>::iterator i = parts.begin(), end = parts.end(); i != end; i++)
+		{
+			i->erase(std::remove(i->begin(), i->end(), '"'), i->end());
+			if(!i->empty())
+				arguments.push_back(*i);
+		}
+		return arguments;
+	}
+
+	//find [-depth <levels>] [-exclude <pattern>]... <root> [<pattern>]
+	bool parse_find_options(std::string const & argument, std::string const & working_directory, find_options & options, std::string & error)
+	{
+		std::vector<std::string> tokens = nil::string::tokenise(argument, " ");
+		std::vector<std::string> positional;
+		for(std::size_t i = 0; i < tokens.size(); i++)
+		{
+			std::string const & token = tokens[i];
+			if(token.empty())
+				continue;
+			if((token == "-depth" || token == "-exclude") && i + 1 >= tokens.size())
+			{
+				error = "Missing value for " + token;
+				return false;
+			}
+			if(token == "-depth")
+			{
+				std::istringstream stream(tokens[++i]);
+				if(!(stream >> options.maximum_depth))
+				{
+					error = "Invalid depth";
+					return false;
+				}
+			}
+			else if(token == "-exclude")
+				options.excluded_patterns.push_back(tokens[++i]);
+			else
+				positional.push_back(token);
+		}
+		if(positional.empty() || positional.size() > 2)
+		{
+			error = "Usage: find [-depth <levels>] [-exclude <pattern>]... <root> [<pattern>]";
+			return false;
+		}
+		options.root = resolve_path(positional[0], working_directory);
+		if(positional.size() == 2)
+			options.pattern = positional[1];
+
+		glob_pattern pattern;
+		if(!pattern.compile(options.pattern, error))
+			return false;
+		for(std::vector<std::string>::const_iterator i = options.excluded_patterns.begin(), end = options.excluded_patterns.end(); i != end; i++)
+		{
+			if(!pattern.compile(*i, error))
+				return false;
+		}
+		return true;
+	}
+
+	//grep <pattern> <files...>, a pattern with spaces or alternations has to be quoted
+	bool parse_grep_arguments(std::string const & argument, std::string const & working_directory, grep_pattern & pattern, std::vector<std::string> & paths, std::string & error)
+	{
+		std::vector<std::string> positional = get_arguments(argument);
+		if(positional.size() < 2)
+		{
+			error = "Usage: grep <pattern> <files...>";
+			return false;
+		}
+		if(!pattern.compile(positional[0], error))
+			return false;
+		for(std::vector<std::string>::const_iterator i = positional.begin() + 1, end = positional.end(); i != end; i++)
+			paths.push_back(resolve_path(*i, working_directory));
+		return true;
+	}
+
+	void split_stage(std::string const & stage, std::string & name, std::string & argument)
+	{
+		std::string trimmed = nil::string::trim(stage);
+		std::size_t space_offset = trimmed.find(' ');
+		if(space_offset == std::string::npos)
+		{
+			name = trimmed;
+			argument.clear();
+		}
+		else
+		{
+			name = trimmed.substr(0, space_offset);
+			argument = nil::string::trim(trimmed.substr(space_offset + 1));
+		}
+	}
+
+	//dir [-long] [-sort name|size|time] [<directory>] | dir [-long] [-sort name|size|time] [<directory>\]<pattern>
+	bool parse_directory_options(std::string const & argument, std::string const & working_directory, directory_options & options, std::string & error)
+	{
+		//Options come first since the directory may contain spaces
+		std::string remainder = argument;
+		while(!remainder.empty() && remainder[0] == '-')
+		{
+			std::string option;
+			split_stage(remainder, option, remainder);
+			if(option == "-long")
+				options.long_format = true;
+			else if(option == "-sort")
+			{
+				std::string order;
+				split_stage(remainder, order, remainder);
+				if(order == "name")
+					options.order = listing_order_name;
+				else if(order == "size")
+					options.order = listing_order_size;
+				else if(order == "time")
+					options.order = listing_order_time;
+				else
+				{
+					error = order.empty() ? "Missing value for -sort" : "Invalid sort order";
+					return false;
+				}
+				options.sorted = true;
+			}
+			else
+			{
+				error = "Usage: dir [-long] [-sort name|size|time] [<directory>][<pattern>]";
+				return false;
+			}
+		}
+
+		std::size_t separator = remainder.find_last_of("\\/");
+		std::string name = separator == std::string::npos ? remainder : remainder.substr(separator + 1);
+		if(!glob_pattern::has_wildcards(name))
+		{
+			options.path = remainder.empty() ? working_directory : resolve_path(remainder, working_directory);
+			return true;
+		}
+		options.path = separator == std::string::npos ? working_directory : resolve_path(remainder.substr(0, separator), working_directory);
+		return options.filter.compile(name, error);
+	}
+}
+
+void line_batch::clear()
+{
+	text.clear();
+	line_offsets.clear();
+}
+
+void line_batch::add_line(char const * data, std::size_t length)
+{
+	line_offsets.push_back(text.length());
+	text.append(data, length);
+	text.push_back('\n');
+}
+
+void line_batch::add_line(std::string const & line)
+{
+	add_line(line.c_str(), line.length());
+}
+
+std::size_t line_batch::get_line_count() const
+{
+	return line_offsets.size();
+}
+
+void line_batch::get_line(std::size_t index, char const * & data, std::size_t & length) const
+{
+	std::size_t offset = line_offsets[index];
+	std::size_t end = index + 1 < line_offsets.size() ? line_offsets[index + 1] : text.length();
+	data = text.c_str() + offset;
+	length = end - offset - 1;
+}
+
+pipeline_stage::~pipeline_stage()
+{
+}
+
+filter_stage::filter_stage(pipeline_stage * input):
+	input(input)
+{
+}
+
+filter_stage::~filter_stage()
+{
+	delete input;
+}
+
+directory_options::directory_options():
+	sorted(false),
+	order(listing_order_name),
+	long_format(false)
+{
+}
+
+directory_stage::directory_stage(directory_options const & options, directory_cache & listings):
+	options(options),
+	listings(listings),
+	find_handle(INVALID_HANDLE_VALUE),
+	started(false),
+	cached(false),
+	listing_files(false),
+	next_entry(0)
+{
+}
+
+directory_stage::~directory_stage()
+{
+	if(find_handle != INVALID_HANDLE_VALUE)
+		FindClose(find_handle);
+}
+
+bool directory_stage::pull(line_batch & batch)
+{
+	//A listing which is still current is taken from the cache, its entries are then written in batches like sorted ones
+	if(!started && copy_cached_listing())
+	{
+		started = true;
+		cached = true;
+		if(options.sorted)
+			listing.sort(options.order, thread_pool::get_processor_count());
+	}
+
+	if(!cached && (!started || find_handle != INVALID_HANDLE_VALUE))
+	{
+		if(options.sorted)
+		{
+			if(enumerate(batch, sorted_slice_size))
+				return true;
+			listing.sort(options.order, thread_pool::get_processor_count());
+		}
+		else
+		{
+			//The directory is enumerated once, one batch at a time. Directories are written as they arrive and the files
+			//are collected in the listing to be written after them, which keeps them at a few bytes on top of their names.
+			directories.clear();
+			bool more = enumerate(batch, batch_size);
+			write_entries(batch, directories, 0, directories.get_count());
+			if(more)
+				return true;
+			listing_files = true;
+		}
+	}
+
+	//Listings in memory are written in batches, once for the directories and once for the files
+	std::size_t end = std::min(next_entry + batch_size, listing.get_count());
+	write_entries(batch, listing, next_entry, end);
+	next_entry = end;
+	if(next_entry < listing.get_count())
+		return true;
+	if(listing_files)
+		return false;
+	listing_files = true;
+	next_entry = 0;
+	return true;
+}
+
+bool directory_stage::enumerate(line_batch & batch, std::size_t maximum_count)
+{
+	WIN32_FIND_DATAW find_data;
+	BOOL found;
+	if(!started)
+	{
+		started = true;
+		find_handle = FindFirstFileW(utf8::to_wide(options.path + "\\*").c_str(), &find_data);
+		if(find_handle == INVALID_HANDLE_VALUE)
+		{
+			//The error is only written once rather than in the pass of the directories and again in the one of the files
+			batch.add_line("Failed to read directory");
+			listing_files = true;
+			return false;
+		}
+		found = TRUE;
+	}
+	else
+		found = FindNextFileW(find_handle, &find_data);
+
+	for(std::size_t i = 0; found && i < maximum_count; i++)
+	{
+		std::wstring name = find_data.cFileName;
+		bool is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		if(name != L"." && name != L"..")
+		{
+			//Names are filtered as they are enumerated so the pattern never holds back a batch
+			std::string utf8_name = utf8::from_wide(name);
+			if(options.filter.matches(utf8_name))
+			{
+				if(is_directory && !options.sorted)
+					directories.add(utf8_name, find_data);
+				else
+					listing.add(utf8_name, find_data);
+			}
+		}
+		if(i + 1 < maximum_count)
+			found = FindNextFileW(find_handle, &find_data);
+	}
+	if(!found)
+	{
+		FindClose(find_handle);
+		find_handle = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	return true;
+}
+
+bool directory_stage::copy_cached_listing()
+{
+	directory_listing const * cached = listings.find(options.path);
+	if(cached == 0)
+		return false;
+	for(std::size_t i = 0, end = cached->get_count(); i < end; i++)
+	{
+		if(options.filter.matches(cached->get_name_begin(i), cached->get_name_end(i)))
+			listing.add(*cached, i);
+	}
+	return true;
+}
+
+void directory_stage::write_entries(line_batch & batch, directory_listing const & source, std::size_t begin, std::size_t end)
+{
+	for(std::size_t i = begin; i < end; i++)
+	{
+		if(source.is_directory(i) == listing_files)
+			continue;
+		if(!options.long_format)
+		{
+			batch.add_line(source.is_directory(i) ? "[D] " + source.get_name(i) : source.get_name(i));
+			continue;
+		}
+
+		//Times are written in local time like the Windows dir command does
+		unsigned long long write_time = source.get_write_time(i);
+		FILETIME file_time;
+		file_time.dwLowDateTime = static_cast<DWORD>(write_time);
+		file_time.dwHighDateTime = static_cast<DWORD>(write_time >> 32);
+		FILETIME local_time;
+		SYSTEMTIME time;
+		FileTimeToLocalFileTime(&file_time, &local_time);
+		FileTimeToSystemTime(&local_time, &time);
+
+		line_stream.str(std::string());
+		line_stream << std::setfill('0') << std::setw(4) << time.wYear << "-" << std::setw(2) << time.wMonth << "-" << std::setw(2) << time.wDay;
+		line_stream << " " << std::setw(2) << time.wHour << ":" << std::setw(2) << time.wMinute << std::setfill(' ') << std::setw(16);
+		if(source.is_directory(i))
+			line_stream << "<DIR>";
+		else
+			line_stream << source.get_size(i);
+		line_stream << " " << source.get_name(i);
+		batch.add_line(line_stream.str());
+	}
+}
+
+find_stage::find_stage(find_options const & options):
+	find(options, thread_pool::get_processor_count())
+{
+}
+
+bool find_stage::pull(line_batch & batch)
+{
+	//Reading the state first guarantees that no results are added after an empty final take
+	bool finished = find.is_finished();
+	paths.clear();
+	find.take_results(paths, batch_size, worker_wait_timeout);
+	for(std::vector<std::string>::const_iterator i = paths.begin(), end = paths.end(); i != end; i++)
+		batch.add_line(*i);
+	return !finished || paths.size() == batch_size;
+}
+
+grep_stage::grep_stage(grep_pattern const & pattern, std::vector<std::string> const & paths):
+	pattern(pattern),
+	search(this->pattern, paths, thread_pool::get_processor_count())
+{
+}
+
+bool grep_stage::pull(line_batch & batch)
+{
+	lines.clear();
+	bool more = search.take_results(lines, batch_size, worker_wait_timeout);
+	for(std::vector<std::string>::const_iterator i = lines.begin(), end = lines.end(); i != end; i++)
+		batch.add_line(*i);
+	return more;
+}
+
+text_stage::text_stage(std::string const & text):
+	text(text)
+{
+}
+
+bool text_stage::pull(line_batch & batch)
+{
+	batch.add_line(text);
+	return false;
+}
+
+substring_filter_stage::substring_filter_stage(pipeline_stage * input, std::string const & substring):
+	filter_stage(input),
+	substring(substring)
+{
+}
+
+bool substring_filter_stage::pull(line_batch & batch)
+{
+	input_batch.clear();
+	bool more = input->pull(input_batch);
+	for(std::size_t i = 0, end = input_batch.get_line_count(); i < end; i++)
+	{
+		char const * data;
+		std::size_t length;
+		input_batch.get_line(i, data, length);
+		if(std::search(data, data + length, substring.begin(), substring.end()) != data + length || substring.empty())
+			batch.add_line(data, length);
+	}
+	return more;
+}
+
+count_stage::count_stage(pipeline_stage * input):
+	filter_stage(input),
+	line_count(0)
+{
+}
+
+bool count_stage::pull(line_batch & batch)
+{
+	input_batch.clear();
+	bool more = input->pull(input_batch);
+	line_count += input_batch.get_line_count();
+	if(more)
+		return true;
+	std::ostringstream stream;
+	stream << line_count;
+	batch.add_line(stream.str());
+	return false;
+}
+
+pipeline_stage * create_pipeline(std::string const & command, std::string const & working_directory, directory_cache & listings, std::string & error)
+{
+	//A | within quotes belongs to the argument of a stage, such as an alternation in the pattern of grep
+	std::vector<std::string> stages;
+	if(!split_unquoted(command, '|', stages))
+	{
+		error = "Unterminated quote";
+		return 0;
+	}
+	pipeline_stage * output = 0;
+	error.clear();
+	for(std::vector<std::string>::const_iterator i = stages.begin(), end = stages.end(); i != end; i++)
+	{
+		std::string name;
+		std::string argument;
+		split_stage(*i, name, argument);
+
+		bool source = name == "dir" || name == "pwd" || name == "find" || name == "grep";
+		bool filter = name == "filter" || name == "count";
+		if(!source && !filter)
+			error = "No such command";
+		else if(source && output != 0)
+			error = name + " does not take any input";
+		else if(filter && output == 0)
+			error = name + " requires input";
+		if(!error.empty())
+		{
+			delete output;
+			return 0;
+		}
+
+		if(name == "dir")
+		{
+			directory_options options;
+			if(!parse_directory_options(argument, working_directory, options, error))
+				return 0;
+			output = new directory_stage(options, listings);
+		}
+		else if(name == "find")
+		{
+			find_options options;
+			if(!parse_find_options(argument, working_directory, options, error))
+				return 0;
+			output = new find_stage(options);
+		}
+		else if(name == "grep")
+		{
+			grep_pattern pattern;
+			std::vector<std::string> paths;
+			if(!parse_grep_arguments(argument, working_directory, pattern, paths, error))
+				return 0;
+			output = new grep_stage(pattern, paths);
+		}
+		else if(name == "pwd")
+			output = new text_stage(working_directory);
+		else if(name == "filter")
+			output = new substring_filter_stage(output, argument);
+		else if(name == "count")
+			output = new count_stage(output);
+	}
+	if(output == 0)
+		error = "No such command";
+	return output;
+}
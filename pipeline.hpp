@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+#include "find.hpp"
+#include "grep.hpp"
+#include "glob.hpp"
+#include "directory.hpp"
+
+//Lines passed between the stages of a pipeline, every line in the text is terminated by a newline
+struct line_batch
+{
+	std::string text;
+	std::vector<std::size_t> line_offsets;
+
+	void clear();
+	void add_line(char const * data, std::size_t length);
+	void add_line(std::string const & line);
+	std::size_t get_line_count() const;
+	//The line without its newline
+	void get_line(std::size_t index, char const * & data, std::size_t & length) const;
+};
+
+//Stages are pulled from the end of the pipeline and pull at most one batch from their input per call.
+//A call may produce no lines at all so that the caller can interleave other work with long running pipelines.
+class pipeline_stage
+{
+public:
+	virtual ~pipeline_stage();
+	//Returns false once the stage is exhausted, the lines of the final call are still in the batch
+	virtual bool pull(line_batch & batch) = 0;
+};
+
+//Stages which consume the output of another stage own it
+class filter_stage: public pipeline_stage
+{
+public:
+	filter_stage(pipeline_stage * input);
+	~filter_stage();
+
+protected:
+	pipeline_stage * input;
+	line_batch input_batch;
+};
+
+struct directory_options
+{
+	std::string path;
+	glob_pattern filter;
+	//Entries are listed in the order of the file system unless they are sorted
+	bool sorted;
+	listing_order order;
+	//Times of the last write and sizes are listed in front of the names
+	bool long_format;
+
+	directory_options();
+};
+
+class directory_stage: public pipeline_stage
+{
+public:
+	directory_stage(directory_options const & options, directory_cache & listings);
+	~directory_stage();
+	bool pull(line_batch & batch);
+
+private:
+	directory_options options;
+	directory_cache & listings;
+	HANDLE find_handle;
+	bool started;
+	bool cached;
+	//Directories are listed before files, a listing held in memory is gone through once for each
+	bool listing_files;
+	directory_listing listing;
+	//Directories of the current batch of an unsorted enumeration, its files are held back in the listing until the end
+	directory_listing directories;
+	std::size_t next_entry;
+	std::ostringstream line_stream;
+
+	bool enumerate(line_batch & batch, std::size_t maximum_count);
+	bool copy_cached_listing();
+	void write_entries(line_batch & batch, directory_listing const & source, std::size_t begin, std::size_t end);
+};
+
+class find_stage: public pipeline_stage
+{
+public:
+	find_stage(find_options const & options);
+	bool pull(line_batch & batch);
+
+private:
+	parallel_find find;
+	std::vector<std::string> paths;
+};
+
+class grep_stage: public pipeline_stage
+{
+public:
+	grep_stage(grep_pattern const & pattern, std::vector<std::string> const & paths);
+	bool pull(line_batch & batch);
+
+private:
+	grep_pattern pattern;
+	parallel_grep search;
+	std::vector<std::string> lines;
+};
+
+class text_stage: public pipeline_stage
+{
+public:
+	text_stage(std::string const & text);
+	bool pull(line_batch & batch);
+
+private:
+	std::string text;
+};
+
+class substring_filter_stage: public filter_stage
+{
+public:
+	substring_filter_stage(pipeline_stage * input, std::string const & substring);
+	bool pull(line_batch & batch);
+
+private:
+	std::string substring;
+};
+
+class count_stage: public filter_stage
+{
+public:
+	count_stage(pipeline_stage * input);
+	bool pull(line_batch & batch);
+
+private:
+	unsigned long long line_count;
+};
+
+//Builds the stages of a command like "dir | filter .log | count", returns 0 and sets the error if it is invalid
+pipeline_stage * create_pipeline(std::string const & command, std::string const & working_directory, directory_cache & listings, std::string & error);
@@ -0,0 +1,13 @@
+#include <string>
+#include <vector>
+
+#include "../batch.hpp"
+
+//caqypowu-batch <script> <output>
+//The same batch mode as caqypowu --run, for systems other than Windows
+int main(int argc, char ** argv)
+{
+	std::vector<std::string> arguments(1, "--run");
+	arguments.insert(arguments.end(), argv + 1, argv + argc);
+	return run_batch(arguments);
+}
@@ -0,0 +1,825 @@
+#include "windows.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "../utf8.hpp"
+
+namespace
+{
+	//Seconds from the start of 1601, where file times begin, to the start of 1970
+	unsigned long long const file_time_epoch = 11644473600ULL;
+	unsigned long long const file_time_units_per_second = 10000000ULL;
+
+	//Handles are reference counted since a thread may still be running when its handle is closed
+	class kernel_object
+	{
+	public:
+		kernel_object():
+			references(1)
+		{
+		}
+
+		virtual ~kernel_object()
+		{
+		}
+
+		//Returns false if the object was not signalled in time
+		virtual bool wait(DWORD milliseconds) = 0;
+
+		void acquire()
+		{
+			InterlockedIncrement(&references);
+		}
+
+		void release()
+		{
+			if(InterlockedDecrement(&references) == 0)
+				delete this;
+		}
+
+	private:
+		LONG volatile references;
+	};
+
+	kernel_object * get_object(HANDLE handle)
+	{
+		return static_cast<kernel_object *>(handle);
+	}
+
+	timespec get_deadline(DWORD milliseconds)
+	{
+		timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += milliseconds / 1000;
+		deadline.tv_nsec += static_cast<long>(milliseconds % 1000) * 1000000;
+		if(deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		return deadline;
+	}
+
+	//Events, semaphores and threads are all a count which waiting takes from, manual reset objects are never taken from
+	class signal_object: public kernel_object
+	{
+	public:
+		signal_object(bool manual_reset, LONG count, LONG maximum_count):
+			manual_reset(manual_reset),
+			count(count),
+			maximum_count(maximum_count)
+		{
+			pthread_mutex_init(&mutex, 0);
+			pthread_cond_init(&condition, 0);
+		}
+
+		~signal_object()
+		{
+			pthread_cond_destroy(&condition);
+			pthread_mutex_destroy(&mutex);
+		}
+
+		bool wait(DWORD milliseconds)
+		{
+			timespec deadline = get_deadline(milliseconds == INFINITE ? 0 : milliseconds);
+			pthread_mutex_lock(&mutex);
+			while(count == 0)
+			{
+				if(milliseconds == INFINITE)
+					pthread_cond_wait(&condition, &mutex);
+				else if(pthread_cond_timedwait(&condition, &mutex, &deadline) == ETIMEDOUT)
+					break;
+			}
+			bool signalled = count > 0;
+			if(signalled && !manual_reset)
+				count--;
+			pthread_mutex_unlock(&mutex);
+			return signalled;
+		}
+
+		void signal(LONG amount)
+		{
+			pthread_mutex_lock(&mutex);
+			count = std::min(count + amount, maximum_count);
+			pthread_cond_broadcast(&condition);
+			pthread_mutex_unlock(&mutex);
+		}
+
+		void reset()
+		{
+			pthread_mutex_lock(&mutex);
+			count = 0;
+			pthread_mutex_unlock(&mutex);
+		}
+
+	private:
+		bool manual_reset;
+		LONG count;
+		LONG maximum_count;
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+	};
+
+	struct thread_start
+	{
+		LPTHREAD_START_ROUTINE start;
+		LPVOID parameter;
+		signal_object * finished;
+	};
+
+	void * run_thread(void * parameter)
+	{
+		thread_start start = *static_cast<thread_start *>(parameter);
+		delete static_cast<thread_start *>(parameter);
+		start.start(start.parameter);
+		start.finished->signal(1);
+		start.finished->release();
+		return 0;
+	}
+
+	class file_object: public kernel_object
+	{
+	public:
+		file_object(int descriptor):
+			descriptor(descriptor)
+		{
+		}
+
+		~file_object()
+		{
+			::close(descriptor);
+		}
+
+		bool wait(DWORD milliseconds)
+		{
+			return true;
+		}
+
+		int descriptor;
+	};
+
+	//Change notifications stay signalled as long as there are unread events
+	class change_object: public file_object
+	{
+	public:
+		change_object(int descriptor):
+			file_object(descriptor)
+		{
+		}
+
+		bool wait(DWORD milliseconds)
+		{
+			pollfd poll_descriptor;
+			poll_descriptor.fd = descriptor;
+			poll_descriptor.events = POLLIN;
+			poll_descriptor.revents = 0;
+			return poll(&poll_descriptor, 1, milliseconds == INFINITE ? -1 : static_cast<int>(milliseconds)) > 0;
+		}
+	};
+
+	struct find_object
+	{
+		DIR * directory;
+		std::string pattern;
+	};
+
+	//Views have to be unmapped with their length, which UnmapViewOfFile does not get
+	pthread_mutex_t view_mutex = PTHREAD_MUTEX_INITIALIZER;
+	std::map<void const *, std::size_t> view_lengths;
+
+	std::string get_path(wchar_t const * path)
+	{
+		std::string output = utf8::from_wide(path);
+		std::replace(output.begin(), output.end(), '\\', '/');
+		return output;
+	}
+
+	void set_file_time(unsigned long long time, FILETIME & file_time)
+	{
+		file_time.dwLowDateTime = static_cast<DWORD>(time);
+		file_time.dwHighDateTime = static_cast<DWORD>(time >> 32);
+	}
+
+	unsigned long long get_file_time(FILETIME const & file_time)
+	{
+		return (static_cast<unsigned long long>(file_time.dwHighDateTime) << 32) | file_time.dwLowDateTime;
+	}
+
+	unsigned long long get_file_time(timespec const & time)
+	{
+		return (static_cast<unsigned long long>(time.tv_sec) + file_time_epoch) * file_time_units_per_second + static_cast<unsigned long long>(time.tv_nsec) / 100;
+	}
+
+	//Fills in the next entry of the directory which matches the pattern, the names are compared without regard to case like on Windows
+	bool find_next_entry(find_object & find, WIN32_FIND_DATAW & find_data)
+	{
+		while(dirent * entry = readdir(find.directory))
+		{
+			if(fnmatch(find.pattern.c_str(), entry->d_name, FNM_CASEFOLD) != 0)
+				continue;
+			struct stat status;
+			if(fstatat(dirfd(find.directory), entry->d_name, &status, 0) != 0 && fstatat(dirfd(find.directory), entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+				continue;
+			std::wstring name = utf8::to_wide(entry->d_name);
+			if(name.length() >= MAX_PATH)
+				continue;
+			std::memset(&find_data, 0, sizeof(find_data));
+			std::copy(name.begin(), name.end(), find_data.cFileName);
+			find_data.dwFileAttributes = S_ISDIR(status.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+			unsigned long long size = S_ISDIR(status.st_mode) ? 0 : static_cast<unsigned long long>(status.st_size);
+			find_data.nFileSizeHigh = static_cast<DWORD>(size >> 32);
+			find_data.nFileSizeLow = static_cast<DWORD>(size);
+			set_file_time(get_file_time(status.st_mtim), find_data.ftLastWriteTime);
+			set_file_time(get_file_time(status.st_ctim), find_data.ftCreationTime);
+			set_file_time(get_file_time(status.st_atim), find_data.ftLastAccessTime);
+			return true;
+		}
+		return false;
+	}
+}
+
+void InitializeCriticalSection(CRITICAL_SECTION * section)
+{
+	pthread_mutexattr_t attributes;
+	pthread_mutexattr_init(&attributes);
+	pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&section->mutex, &attributes);
+	pthread_mutexattr_destroy(&attributes);
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION * section)
+{
+	pthread_mutex_destroy(&section->mutex);
+}
+
+void EnterCriticalSection(CRITICAL_SECTION * section)
+{
+	pthread_mutex_lock(&section->mutex);
+}
+
+void LeaveCriticalSection(CRITICAL_SECTION * section)
+{
+	pthread_mutex_unlock(&section->mutex);
+}
+
+HANDLE CreateThread(void * attributes, SIZE_T stack_size, LPTHREAD_START_ROUTINE start, LPVOID parameter, DWORD flags, DWORD * identifier)
+{
+	//The thread holds a reference to its handle to signal it once it returns
+	signal_object * finished = new signal_object(true, 0, 1);
+	finished->acquire();
+	thread_start * thread_parameter = new thread_start;
+	thread_parameter->start = start;
+	thread_parameter->parameter = parameter;
+	thread_parameter->finished = finished;
+	pthread_t thread;
+	if(pthread_create(&thread, 0, &run_thread, thread_parameter) != 0)
+	{
+		delete thread_parameter;
+		finished->release();
+		finished->release();
+		return 0;
+	}
+	pthread_detach(thread);
+	return finished;
+}
+
+HANDLE CreateSemaphore(void * attributes, LONG initial_count, LONG maximum_count, LPCSTR name)
+{
+	return static_cast<kernel_object *>(new signal_object(false, initial_count, maximum_count));
+}
+
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG * previous_count)
+{
+	static_cast<signal_object *>(get_object(semaphore))->signal(count);
+	return TRUE;
+}
+
+HANDLE CreateEvent(void * attributes, BOOL manual_reset, BOOL initial_state, LPCSTR name)
+{
+	return static_cast<kernel_object *>(new signal_object(manual_reset != FALSE, initial_state ? 1 : 0, 1));
+}
+
+BOOL SetEvent(HANDLE event)
+{
+	static_cast<signal_object *>(get_object(event))->signal(1);
+	return TRUE;
+}
+
+BOOL ResetEvent(HANDLE event)
+{
+	static_cast<signal_object *>(get_object(event))->reset();
+	return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+	return get_object(handle)->wait(milliseconds) ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+	if(handle == 0 || handle == INVALID_HANDLE_VALUE)
+		return FALSE;
+	get_object(handle)->release();
+	return TRUE;
+}
+
+void Sleep(DWORD milliseconds)
+{
+	timespec duration;
+	duration.tv_sec = milliseconds / 1000;
+	duration.tv_nsec = static_cast<long>(milliseconds % 1000) * 1000000;
+	while(nanosleep(&duration, &duration) != 0 && errno == EINTR);
+}
+
+void GetSystemInfo(SYSTEM_INFO * system_info)
+{
+	long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+	system_info->dwNumberOfProcessors = processor_count > 0 ? static_cast<DWORD>(processor_count) : 1;
+	system_info->dwPageSize = static_cast<DWORD>(sysconf(_SC_PAGESIZE));
+	system_info->dwAllocationGranularity = system_info->dwPageSize;
+}
+
+HANDLE CreateFileW(wchar_t const * path, DWORD access, DWORD share_mode, void * attributes, DWORD disposition, DWORD flags, HANDLE template_file)
+{
+	int open_flags = O_CLOEXEC;
+	if((access & GENERIC_READ) && (access & GENERIC_WRITE))
+		open_flags |= O_RDWR;
+	else if(access & GENERIC_WRITE)
+		open_flags |= O_WRONLY;
+	else
+		open_flags |= O_RDONLY;
+	if(disposition == CREATE_NEW)
+		open_flags |= O_CREAT | O_EXCL;
+	else if(disposition == CREATE_ALWAYS)
+		open_flags |= O_CREAT | O_TRUNC;
+	else if(disposition == OPEN_ALWAYS)
+		open_flags |= O_CREAT;
+
+	int descriptor = open(get_path(path).c_str(), open_flags, 0666);
+	if(descriptor < 0)
+		return INVALID_HANDLE_VALUE;
+	//Directories can only be opened with backup semantics on Windows
+	struct stat status;
+	if(fstat(descriptor, &status) != 0 || S_ISDIR(status.st_mode))
+	{
+		::close(descriptor);
+		return INVALID_HANDLE_VALUE;
+	}
+	return static_cast<kernel_object *>(new file_object(descriptor));
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER * size)
+{
+	struct stat status;
+	if(fstat(static_cast<file_object *>(get_object(file))->descriptor, &status) != 0)
+		return FALSE;
+	size->QuadPart = status.st_size;
+	return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, LARGE_INTEGER * position, DWORD method)
+{
+	int whence = method == FILE_END ? SEEK_END : method == FILE_CURRENT ? SEEK_CUR : SEEK_SET;
+	off_t offset = lseek(static_cast<file_object *>(get_object(file))->descriptor, static_cast<off_t>(distance.QuadPart), whence);
+	if(offset < 0)
+		return FALSE;
+	if(position != 0)
+		position->QuadPart = offset;
+	return TRUE;
+}
+
+BOOL WriteFile(HANDLE file, void const * data, DWORD length, DWORD * written, void * overlapped)
+{
+	int descriptor = static_cast<file_object *>(get_object(file))->descriptor;
+	char const * bytes = static_cast<char const *>(data);
+	DWORD total = 0;
+	while(total < length)
+	{
+		ssize_t result = write(descriptor, bytes + total, length - total);
+		if(result < 0 && errno == EINTR)
+			continue;
+		if(result <= 0)
+			break;
+		total += static_cast<DWORD>(result);
+	}
+	if(written != 0)
+		*written = total;
+	return total == length;
+}
+
+BOOL FlushFileBuffers(HANDLE file)
+{
+	return fsync(static_cast<file_object *>(get_object(file))->descriptor) == 0;
+}
+
+HANDLE CreateFileMappingW(HANDLE file, void * attributes, DWORD protection, DWORD size_high, DWORD size_low, wchar_t const * name)
+{
+	//The mapping keeps the file open on its own like on Windows
+	int descriptor = dup(static_cast<file_object *>(get_object(file))->descriptor);
+	if(descriptor < 0)
+		return 0;
+	return static_cast<kernel_object *>(new file_object(descriptor));
+}
+
+void * MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high, DWORD offset_low, SIZE_T length)
+{
+	int descriptor = static_cast<file_object *>(get_object(mapping))->descriptor;
+	off_t offset = static_cast<off_t>((static_cast<unsigned long long>(offset_high) << 32) | offset_low);
+	if(length == 0)
+	{
+		struct stat status;
+		if(fstat(descriptor, &status) != 0 || status.st_size <= offset)
+			return 0;
+		length = static_cast<SIZE_T>(status.st_size - offset);
+	}
+	void * data = mmap(0, length, PROT_READ, MAP_PRIVATE, descriptor, offset);
+	if(data == MAP_FAILED)
+		return 0;
+	pthread_mutex_lock(&view_mutex);
+	view_lengths[data] = length;
+	pthread_mutex_unlock(&view_mutex);
+	return data;
+}
+
+BOOL UnmapViewOfFile(void const * data)
+{
+	pthread_mutex_lock(&view_mutex);
+	std::map<void const *, std::size_t>::iterator view = view_lengths.find(data);
+	bool found = view != view_lengths.end();
+	if(found)
+	{
+		munmap(const_cast<void *>(data), view->second);
+		view_lengths.erase(view);
+	}
+	pthread_mutex_unlock(&view_mutex);
+	return found;
+}
+
+BOOL CreateDirectoryW(wchar_t const * path, void * attributes)
+{
+	return mkdir(get_path(path).c_str(), 0777) == 0;
+}
+
+DWORD GetFileAttributesW(wchar_t const * path)
+{
+	struct stat status;
+	if(stat(get_path(path).c_str(), &status) != 0)
+		return INVALID_FILE_ATTRIBUTES;
+	return S_ISDIR(status.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+HANDLE FindFirstFileW(wchar_t const * pattern, WIN32_FIND_DATAW * find_data)
+{
+	std::string path = get_path(pattern);
+	std::size_t separator = path.rfind('/');
+	std::string directory = separator == std::string::npos ? "." : separator == 0 ? "/" : path.substr(0, separator);
+	find_object * find = new find_object;
+	find->pattern = separator == std::string::npos ? path : path.substr(separator + 1);
+	//On Windows *.* also matches names without an extension
+	if(find->pattern == "*.*")
+		find->pattern = "*";
+	find->directory = opendir(directory.c_str());
+	if(find->directory == 0 || !find_next_entry(*find, *find_data))
+	{
+		FindClose(find);
+		return INVALID_HANDLE_VALUE;
+	}
+	return find;
+}
+
+BOOL FindNextFileW(HANDLE find_handle, WIN32_FIND_DATAW * find_data)
+{
+	return find_next_entry(*static_cast<find_object *>(find_handle), *find_data);
+}
+
+BOOL FindClose(HANDLE find_handle)
+{
+	find_object * find = static_cast<find_object *>(find_handle);
+	if(find->directory != 0)
+		closedir(find->directory);
+	delete find;
+	return TRUE;
+}
+
+HANDLE FindFirstChangeNotificationW(wchar_t const * path, BOOL watch_subtree, DWORD filter)
+{
+#ifdef __linux__
+	int descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(descriptor < 0)
+		return INVALID_HANDLE_VALUE;
+	uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+	if(inotify_add_watch(descriptor, get_path(path).c_str(), mask) < 0)
+	{
+		::close(descriptor);
+		return INVALID_HANDLE_VALUE;
+	}
+	return static_cast<kernel_object *>(new change_object(descriptor));
+#else
+	//Without notifications every listing is read again when it is used
+	return INVALID_HANDLE_VALUE;
+#endif
+}
+
+BOOL FindCloseChangeNotification(HANDLE change_handle)
+{
+	return CloseHandle(change_handle);
+}
+
+BOOL SetCurrentDirectoryW(wchar_t const * path)
+{
+	return chdir(get_path(path).c_str()) == 0;
+}
+
+DWORD GetCurrentDirectoryW(DWORD length, wchar_t * buffer)
+{
+	char path[4096];
+	if(getcwd(path, sizeof(path)) == 0)
+		return 0;
+	std::wstring wide_path = utf8::to_wide(path);
+	if(wide_path.length() >= length)
+		return static_cast<DWORD>(wide_path.length() + 1);
+	std::copy(wide_path.begin(), wide_path.end(), buffer);
+	buffer[wide_path.length()] = 0;
+	return static_cast<DWORD>(wide_path.length());
+}
+
+DWORD GetTickCount()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<DWORD>(static_cast<unsigned long long>(now.tv_sec) * 1000 + static_cast<unsigned long long>(now.tv_nsec) / 1000000);
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER * counter)
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	counter->QuadPart = static_cast<LONGLONG>(now.tv_sec) * 1000000000 + now.tv_nsec;
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER * frequency)
+{
+	frequency->QuadPart = 1000000000;
+	return TRUE;
+}
+
+void GetSystemTimeAsFileTime(FILETIME * time)
+{
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	set_file_time(get_file_time(now), *time);
+}
+
+HANDLE GetCurrentProcess()
+{
+	return INVALID_HANDLE_VALUE;
+}
+
+BOOL GetProcessTimes(HANDLE process, FILETIME * creation_time, FILETIME * exit_time, FILETIME * kernel_time, FILETIME * user_time)
+{
+	//The creation time of the process is not available portably, callers fall back to the current time
+	return FALSE;
+}
+
+BOOL FileTimeToLocalFileTime(FILETIME const * time, FILETIME * local_time)
+{
+	time_t seconds = static_cast<time_t>(get_file_time(*time) / file_time_units_per_second - file_time_epoch);
+	tm local;
+	if(localtime_r(&seconds, &local) == 0)
+		return FALSE;
+	set_file_time(get_file_time(*time) + static_cast<unsigned long long>(local.tm_gmtoff * static_cast<long long>(file_time_units_per_second)), *local_time);
+	return TRUE;
+}
+
+BOOL FileTimeToSystemTime(FILETIME const * time, SYSTEMTIME * system_time)
+{
+	unsigned long long file_time = get_file_time(*time);
+	time_t seconds = static_cast<time_t>(file_time / file_time_units_per_second - file_time_epoch);
+	tm universal;
+	if(gmtime_r(&seconds, &universal) == 0)
+		return FALSE;
+	system_time->wYear = static_cast<WORD>(universal.tm_year + 1900);
+	system_time->wMonth = static_cast<WORD>(universal.tm_mon + 1);
+	system_time->wDayOfWeek = static_cast<WORD>(universal.tm_wday);
+	system_time->wDay = static_cast<WORD>(universal.tm_mday);
+	system_time->wHour = static_cast<WORD>(universal.tm_hour);
+	system_time->wMinute = static_cast<WORD>(universal.tm_min);
+	system_time->wSecond = static_cast<WORD>(universal.tm_sec);
+	system_time->wMilliseconds = static_cast<WORD>(file_time % file_time_units_per_second / 10000);
+	return TRUE;
+}
+
+//There is no window to post to, to draw in or to time, so none of these have an effect
+
+UINT_PTR SetTimer(HWND window, UINT_PTR identifier, UINT elapse, TIMERPROC timer_function)
+{
+	return identifier;
+}
+
+BOOL KillTimer(HWND window, UINT_PTR identifier)
+{
+	return TRUE;
+}
+
+BOOL PostMessage(HWND window, UINT message, WPARAM wParam, LPARAM lParam)
+{
+	return FALSE;
+}
+
+BOOL MessageBeep(UINT type)
+{
+	return TRUE;
+}
+
+BOOL GetClientRect(HWND window, RECT * rectangle)
+{
+	SetRect(rectangle, 0, 0, 0, 0);
+	return FALSE;
+}
+
+BOOL InvalidateRect(HWND window, RECT const * rectangle, BOOL erase)
+{
+	return FALSE;
+}
+
+HDC BeginPaint(HWND window, PAINTSTRUCT * paint)
+{
+	std::memset(paint, 0, sizeof(*paint));
+	return 0;
+}
+
+BOOL EndPaint(HWND window, PAINTSTRUCT const * paint)
+{
+	return TRUE;
+}
+
+HDC CreateCompatibleDC(HDC dc)
+{
+	return 0;
+}
+
+HBITMAP CreateCompatibleBitmap(HDC dc, int width, int height)
+{
+	return 0;
+}
+
+HGDIOBJ SelectObject(HDC dc, HGDIOBJ object)
+{
+	return 0;
+}
+
+BOOL DeleteObject(HGDIOBJ object)
+{
+	return TRUE;
+}
+
+BOOL DeleteDC(HDC dc)
+{
+	return TRUE;
+}
+
+HGDIOBJ GetStockObject(int object)
+{
+	return 0;
+}
+
+BOOL BitBlt(HDC dc, int x, int y, int width, int height, HDC source, int source_x, int source_y, DWORD operation)
+{
+	return FALSE;
+}
+
+HFONT CreateFont(int height, int width, int escapement, int orientation, int weight, DWORD italic, DWORD underline, DWORD strike_out, DWORD character_set, DWORD output_precision, DWORD clip_precision, DWORD quality, DWORD pitch_and_family, LPCSTR face_name)
+{
+	return 0;
+}
+
+HBRUSH CreateSolidBrush(COLORREF colour)
+{
+	return 0;
+}
+
+HPEN CreatePen(int style, int width, COLORREF colour)
+{
+	return 0;
+}
+
+BOOL SetRect(RECT * rectangle, int left, int top, int right, int bottom)
+{
+	rectangle->left = left;
+	rectangle->top = top;
+	rectangle->right = right;
+	rectangle->bottom = bottom;
+	return TRUE;
+}
+
+int FillRect(HDC dc, RECT const * rectangle, HBRUSH brush)
+{
+	return 0;
+}
+
+BOOL Polyline(HDC dc, POINT const * points, int count)
+{
+	return FALSE;
+}
+
+BOOL TextOut(HDC dc, int x, int y, LPCSTR text, int length)
+{
+	return FALSE;
+}
+
+BOOL ExtTextOutW(HDC dc, int x, int y, UINT options, RECT const * rectangle, wchar_t const * text, UINT length, INT const * distances)
+{
+	return FALSE;
+}
+
+COLORREF SetTextColor(HDC dc, COLORREF colour)
+{
+	return 0;
+}
+
+COLORREF SetBkColor(HDC dc, COLORREF colour)
+{
+	return 0;
+}
+
+int SetBkMode(HDC dc, int mode)
+{
+	return 0;
+}
+
+COLORREF SetDCPenColor(HDC dc, COLORREF colour)
+{
+	return 0;
+}
+
+//There is no clipboard either, copying and pasting fails
+
+HGLOBAL GlobalAlloc(UINT flags, SIZE_T size)
+{
+	return 0;
+}
+
+void * GlobalLock(HGLOBAL memory)
+{
+	return 0;
+}
+
+BOOL GlobalUnlock(HGLOBAL memory)
+{
+	return FALSE;
+}
+
+HGLOBAL GlobalFree(HGLOBAL memory)
+{
+	return memory;
+}
+
+BOOL OpenClipboard(HWND window)
+{
+	return FALSE;
+}
+
+BOOL CloseClipboard()
+{
+	return FALSE;
+}
+
+BOOL EmptyClipboard()
+{
+	return FALSE;
+}
+
+BOOL IsClipboardFormatAvailable(UINT format)
+{
+	return FALSE;
+}
+
+HANDLE GetClipboardData(UINT format)
+{
+	return 0;
+}
+
+HANDLE SetClipboardData(UINT format, HANDLE data)
+{
+	return 0;
+}
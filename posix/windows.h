@@ -0,0 +1,314 @@
+#pragma once
+
+//The part of the Windows API which the console engine uses, implemented on POSIX so that batch mode can be built and tested
+//on other systems. Paths are converted from UTF-16 to UTF-8 with \ turned into /. Drawing, the clipboard and timers do nothing
+//since a console without a window never uses them.
+
+#include <cstddef>
+
+#include <pthread.h>
+
+#define WINAPI
+#define CALLBACK
+
+typedef int BOOL;
+typedef int INT;
+typedef unsigned int UINT;
+typedef short SHORT;
+typedef unsigned short WORD;
+typedef unsigned char BYTE;
+//DWORD keeps the 32 bits it has on Windows, LONG is as wide as a pointer so that positions kept in it never wrap around
+typedef unsigned int DWORD;
+typedef long LONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef std::size_t SIZE_T;
+typedef std::size_t UINT_PTR;
+typedef long LONG_PTR;
+typedef std::size_t WPARAM;
+typedef long LPARAM;
+typedef long LRESULT;
+typedef char * LPSTR;
+typedef char const * LPCSTR;
+typedef void * LPVOID;
+typedef DWORD COLORREF;
+
+typedef void * HANDLE;
+typedef void * HGLOBAL;
+typedef void * HGDIOBJ;
+typedef struct HWND__ * HWND;
+typedef struct HDC__ * HDC;
+typedef struct HBITMAP__ * HBITMAP;
+typedef struct HFONT__ * HFONT;
+typedef struct HBRUSH__ * HBRUSH;
+typedef struct HPEN__ * HPEN;
+typedef struct HINSTANCE__ * HINSTANCE;
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xffffffff
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-1)))
+#define INVALID_FILE_ATTRIBUTES (static_cast<DWORD>(-1))
+
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+
+struct POINT
+{
+	LONG x;
+	LONG y;
+};
+
+struct FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+};
+
+struct SYSTEMTIME
+{
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+};
+
+union LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	} u;
+	LONGLONG QuadPart;
+};
+
+struct SYSTEM_INFO
+{
+	DWORD dwNumberOfProcessors;
+	DWORD dwPageSize;
+	DWORD dwAllocationGranularity;
+};
+
+//Threads and synchronisation
+
+struct CRITICAL_SECTION
+{
+	pthread_mutex_t mutex;
+};
+
+typedef DWORD (WINAPI * LPTHREAD_START_ROUTINE)(LPVOID parameter);
+
+void InitializeCriticalSection(CRITICAL_SECTION * section);
+void DeleteCriticalSection(CRITICAL_SECTION * section);
+void EnterCriticalSection(CRITICAL_SECTION * section);
+void LeaveCriticalSection(CRITICAL_SECTION * section);
+
+HANDLE CreateThread(void * attributes, SIZE_T stack_size, LPTHREAD_START_ROUTINE start, LPVOID parameter, DWORD flags, DWORD * identifier);
+HANDLE CreateSemaphore(void * attributes, LONG initial_count, LONG maximum_count, LPCSTR name);
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG * previous_count);
+HANDLE CreateEvent(void * attributes, BOOL manual_reset, BOOL initial_state, LPCSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+BOOL CloseHandle(HANDLE handle);
+void Sleep(DWORD milliseconds);
+void GetSystemInfo(SYSTEM_INFO * system_info);
+
+inline LONG InterlockedIncrement(LONG volatile * value)
+{
+	return __sync_add_and_fetch(value, 1);
+}
+
+inline LONG InterlockedDecrement(LONG volatile * value)
+{
+	return __sync_sub_and_fetch(value, 1);
+}
+
+inline LONG InterlockedExchange(LONG volatile * target, LONG value)
+{
+	__sync_synchronize();
+	return __sync_lock_test_and_set(target, value);
+}
+
+inline LONG InterlockedExchangeAdd(LONG volatile * target, LONG value)
+{
+	return __sync_fetch_and_add(target, value);
+}
+
+inline LONG InterlockedCompareExchange(LONG volatile * target, LONG value, LONG comparand)
+{
+	return __sync_val_compare_and_swap(target, comparand, value);
+}
+
+inline LONGLONG InterlockedExchangeAdd64(LONGLONG volatile * target, LONGLONG value)
+{
+	return __sync_fetch_and_add(target, value);
+}
+
+inline LONGLONG InterlockedCompareExchange64(LONGLONG volatile * target, LONGLONG value, LONGLONG comparand)
+{
+	return __sync_val_compare_and_swap(target, comparand, value);
+}
+
+//Files
+
+#define MAX_PATH 260
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 1
+#define FILE_SHARE_WRITE 2
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+#define FILE_NOTIFY_CHANGE_FILE_NAME 1
+#define FILE_NOTIFY_CHANGE_DIR_NAME 2
+#define FILE_NOTIFY_CHANGE_ATTRIBUTES 4
+#define FILE_NOTIFY_CHANGE_SIZE 8
+#define FILE_NOTIFY_CHANGE_LAST_WRITE 16
+
+struct WIN32_FIND_DATAW
+{
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+	wchar_t cFileName[MAX_PATH];
+};
+
+HANDLE CreateFileW(wchar_t const * path, DWORD access, DWORD share_mode, void * attributes, DWORD disposition, DWORD flags, HANDLE template_file);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER * size);
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, LARGE_INTEGER * position, DWORD method);
+BOOL WriteFile(HANDLE file, void const * data, DWORD length, DWORD * written, void * overlapped);
+BOOL FlushFileBuffers(HANDLE file);
+HANDLE CreateFileMappingW(HANDLE file, void * attributes, DWORD protection, DWORD size_high, DWORD size_low, wchar_t const * name);
+void * MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high, DWORD offset_low, SIZE_T length);
+BOOL UnmapViewOfFile(void const * data);
+BOOL CreateDirectoryW(wchar_t const * path, void * attributes);
+DWORD GetFileAttributesW(wchar_t const * path);
+HANDLE FindFirstFileW(wchar_t const * pattern, WIN32_FIND_DATAW * find_data);
+BOOL FindNextFileW(HANDLE find_handle, WIN32_FIND_DATAW * find_data);
+BOOL FindClose(HANDLE find_handle);
+HANDLE FindFirstChangeNotificationW(wchar_t const * path, BOOL watch_subtree, DWORD filter);
+BOOL FindCloseChangeNotification(HANDLE change_handle);
+BOOL SetCurrentDirectoryW(wchar_t const * path);
+DWORD GetCurrentDirectoryW(DWORD length, wchar_t * buffer);
+
+//Time
+
+DWORD GetTickCount();
+BOOL QueryPerformanceCounter(LARGE_INTEGER * counter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER * frequency);
+void GetSystemTimeAsFileTime(FILETIME * time);
+HANDLE GetCurrentProcess();
+BOOL GetProcessTimes(HANDLE process, FILETIME * creation_time, FILETIME * exit_time, FILETIME * kernel_time, FILETIME * user_time);
+BOOL FileTimeToLocalFileTime(FILETIME const * time, FILETIME * local_time);
+BOOL FileTimeToSystemTime(FILETIME const * time, SYSTEMTIME * system_time);
+
+//Windows, input and drawing
+
+#define RGB(r, g, b) (static_cast<COLORREF>(static_cast<BYTE>(r) | (static_cast<WORD>(static_cast<BYTE>(g)) << 8) | (static_cast<DWORD>(static_cast<BYTE>(b)) << 16)))
+#define MB_ICONASTERISK 0x40
+#define SRCCOPY 0xcc0020
+#define PS_SOLID 0
+#define TRANSPARENT 1
+#define OPAQUE 2
+#define DC_PEN 19
+#define ETO_OPAQUE 2
+#define FW_NORMAL 400
+#define DEFAULT_CHARSET 1
+#define OUT_DEFAULT_PRECIS 0
+#define CLIP_DEFAULT_PRECIS 0
+#define DEFAULT_QUALITY 0
+#define DEFAULT_PITCH 0
+#define FF_MODERN 0x30
+#define GMEM_MOVEABLE 2
+#define CF_UNICODETEXT 13
+
+enum
+{
+	VK_BACK = 0x08,
+	VK_TAB = 0x09,
+	VK_RETURN = 0x0d,
+	VK_SHIFT = 0x10,
+	VK_CONTROL = 0x11,
+	VK_ESCAPE = 0x1b,
+	VK_PRIOR = 0x21,
+	VK_NEXT = 0x22,
+	VK_END = 0x23,
+	VK_HOME = 0x24,
+	VK_LEFT = 0x25,
+	VK_UP = 0x26,
+	VK_RIGHT = 0x27,
+	VK_DOWN = 0x28,
+	VK_DELETE = 0x2e,
+};
+
+struct PAINTSTRUCT
+{
+	HDC hdc;
+	BOOL fErase;
+	RECT rcPaint;
+};
+
+typedef void (CALLBACK * TIMERPROC)(HWND window, UINT message, UINT_PTR identifier, DWORD time);
+
+UINT_PTR SetTimer(HWND window, UINT_PTR identifier, UINT elapse, TIMERPROC timer_function);
+BOOL KillTimer(HWND window, UINT_PTR identifier);
+BOOL PostMessage(HWND window, UINT message, WPARAM wParam, LPARAM lParam);
+BOOL MessageBeep(UINT type);
+BOOL GetClientRect(HWND window, RECT * rectangle);
+BOOL InvalidateRect(HWND window, RECT const * rectangle, BOOL erase);
+HDC BeginPaint(HWND window, PAINTSTRUCT * paint);
+BOOL EndPaint(HWND window, PAINTSTRUCT const * paint);
+HDC CreateCompatibleDC(HDC dc);
+HBITMAP CreateCompatibleBitmap(HDC dc, int width, int height);
+HGDIOBJ SelectObject(HDC dc, HGDIOBJ object);
+BOOL DeleteObject(HGDIOBJ object);
+BOOL DeleteDC(HDC dc);
+HGDIOBJ GetStockObject(int object);
+BOOL BitBlt(HDC dc, int x, int y, int width, int height, HDC source, int source_x, int source_y, DWORD operation);
+HFONT CreateFont(int height, int width, int escapement, int orientation, int weight, DWORD italic, DWORD underline, DWORD strike_out, DWORD character_set, DWORD output_precision, DWORD clip_precision, DWORD quality, DWORD pitch_and_family, LPCSTR face_name);
+HBRUSH CreateSolidBrush(COLORREF colour);
+HPEN CreatePen(int style, int width, COLORREF colour);
+BOOL SetRect(RECT * rectangle, int left, int top, int right, int bottom);
+int FillRect(HDC dc, RECT const * rectangle, HBRUSH brush);
+BOOL Polyline(HDC dc, POINT const * points, int count);
+BOOL TextOut(HDC dc, int x, int y, LPCSTR text, int length);
+BOOL ExtTextOutW(HDC dc, int x, int y, UINT options, RECT const * rectangle, wchar_t const * text, UINT length, INT const * distances);
+COLORREF SetTextColor(HDC dc, COLORREF colour);
+COLORREF SetBkColor(HDC dc, COLORREF colour);
+int SetBkMode(HDC dc, int mode);
+COLORREF SetDCPenColor(HDC dc, COLORREF colour);
+
+HGLOBAL GlobalAlloc(UINT flags, SIZE_T size);
+void * GlobalLock(HGLOBAL memory);
+BOOL GlobalUnlock(HGLOBAL memory);
+HGLOBAL GlobalFree(HGLOBAL memory);
+BOOL OpenClipboard(HWND window);
+BOOL CloseClipboard();
+BOOL EmptyClipboard();
+BOOL IsClipboardFormatAvailable(UINT format);
+HANDLE GetClipboardData(UINT format);
+HANDLE SetClipboardData(UINT format, HANDLE data);
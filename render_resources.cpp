@@ -0,0 +1,109 @@
+#include "render_resources.hpp"
+
+render_resources::render_resources():
+	font_name("Lucida Console"),
+	font(0),
+	font_width(8),
+	font_height(12),
+	background_colour(RGB(0, 0, 0)),
+	text_colour(RGB(255, 255, 255)),
+	background_brush(0),
+	foreground_pen(0),
+	buffer_dc(0),
+	bitmap(0),
+	bitmap_width(0),
+	bitmap_height(0)
+{
+}
+
+render_resources::~render_resources()
+{
+	free_bitmap_and_dc();
+
+	if(font != 0)
+	{
+		DeleteObject(font);
+		DeleteObject(background_brush);
+		DeleteObject(foreground_pen);
+	}
+}
+
+HFONT render_resources::get_font()
+{
+	create_objects();
+	return font;
+}
+
+unsigned render_resources::get_font_width() const
+{
+	return font_width;
+}
+
+unsigned render_resources::get_font_height() const
+{
+	return font_height;
+}
+
+COLORREF render_resources::get_background_colour() const
+{
+	return background_colour;
+}
+
+COLORREF render_resources::get_text_colour() const
+{
+	return text_colour;
+}
+
+HBRUSH render_resources::get_background_brush()
+{
+	create_objects();
+	return background_brush;
+}
+
+HPEN render_resources::get_foreground_pen()
+{
+	create_objects();
+	return foreground_pen;
+}
+
+HDC render_resources::get_buffer_dc(HDC window_dc, unsigned width, unsigned height)
+{
+	//The back buffer has some slack so that dragging the border of the window does not recreate it for every pixel
+	if(buffer_dc != 0 && width <= bitmap_width && height <= bitmap_height && width >= bitmap_width / 2 && height >= bitmap_height / 2)
+		return buffer_dc;
+
+	free_bitmap_and_dc();
+	create_objects();
+
+	bitmap_width = (width + width / 4 + 63) / 64 * 64;
+	bitmap_height = (height + height / 4 + 63) / 64 * 64;
+
+	buffer_dc = CreateCompatibleDC(window_dc);
+	bitmap = CreateCompatibleBitmap(window_dc, bitmap_width, bitmap_height);
+
+	SelectObject(buffer_dc, bitmap);
+	SelectObject(buffer_dc, font);
+	SelectObject(buffer_dc, foreground_pen);
+
+	return buffer_dc;
+}
+
+void render_resources::create_objects()
+{
+	if(font != 0)
+		return;
+	font = CreateFont(font_height, font_width, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_MODERN, font_name.c_str());
+	background_brush = CreateSolidBrush(background_colour);
+	foreground_pen = CreatePen(PS_SOLID, 1, text_colour);
+}
+
+void render_resources::free_bitmap_and_dc()
+{
+	if(buffer_dc != 0)
+	{
+		DeleteObject(bitmap);
+		DeleteDC(buffer_dc);
+		buffer_dc = 0;
+		bitmap = 0;
+	}
+}
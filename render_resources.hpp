@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include <windows.h>
+
+//GDI objects shared by all sessions, only the session in the foreground ever draws into the back buffer.
+//The objects are created on the first paint, layout only requires the metrics of the font.
+class render_resources
+{
+public:
+	render_resources();
+	~render_resources();
+
+	HFONT get_font();
+	unsigned get_font_width() const;
+	unsigned get_font_height() const;
+
+	COLORREF get_background_colour() const;
+	COLORREF get_text_colour() const;
+	HBRUSH get_background_brush();
+	HPEN get_foreground_pen();
+
+	HDC get_buffer_dc(HDC window_dc, unsigned width, unsigned height);
+
+private:
+	std::string font_name;
+	HFONT font;
+	unsigned font_width;
+	unsigned font_height;
+
+	COLORREF background_colour;
+	COLORREF text_colour;
+	HBRUSH background_brush;
+	HPEN foreground_pen;
+
+	HDC buffer_dc;
+	HBITMAP bitmap;
+	unsigned bitmap_width;
+	unsigned bitmap_height;
+
+	void create_objects();
+	void free_bitmap_and_dc();
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+//SIMD_SSE2 is defined wherever SSE2 can be used without checking the processor, which is every x64 and x86 target of the compiler
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace simd
+{
+	//The mask must not be zero
+	inline unsigned count_trailing_zeros(unsigned mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+}
@@ -0,0 +1,76 @@
+#include "startup_trace.hpp"
+
+#include <sstream>
+
+#include <windows.h>
+
+#include "timing.hpp"
+
+namespace
+{
+	char const * event_names[] =
+	{
+		"WinMain entered",
+		"Window created",
+		"First paint",
+		"Interactive",
+	};
+
+	unsigned long long event_times[startup_event_count];
+	bool event_marked[startup_event_count];
+	unsigned long long process_start = 0;
+
+	unsigned long long get_file_time(FILETIME const & time)
+	{
+		return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	}
+
+	//The creation time of the process is only available as wall clock time, it is converted to the timeline of get_microseconds
+	void determine_process_start()
+	{
+		FILETIME creation_time;
+		FILETIME exit_time;
+		FILETIME kernel_time;
+		FILETIME user_time;
+		FILETIME now;
+		unsigned long long now_microseconds = get_microseconds();
+		GetSystemTimeAsFileTime(&now);
+		if(!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		{
+			process_start = now_microseconds;
+			return;
+		}
+		unsigned long long age = (get_file_time(now) - get_file_time(creation_time)) / 10;
+		process_start = age < now_microseconds ? now_microseconds - age : 0;
+	}
+}
+
+void mark_startup_event(startup_event event)
+{
+	if(event_marked[event])
+		return;
+	if(process_start == 0)
+		determine_process_start();
+	event_times[event] = get_microseconds();
+	event_marked[event] = true;
+}
+
+bool is_startup_event_marked(startup_event event)
+{
+	return event_marked[event];
+}
+
+std::string format_startup_trace()
+{
+	std::ostringstream stream;
+	stream << "Startup, milliseconds since the process was created:\n";
+	for(unsigned i = 0; i < startup_event_count; i++)
+	{
+		stream << "  " << event_names[i] << ": ";
+		if(event_marked[i])
+			stream << (event_times[i] - process_start) / 1000 << "." << (event_times[i] - process_start) / 100 % 10 << "\n";
+		else
+			stream << "pending\n";
+	}
+	return stream.str();
+}
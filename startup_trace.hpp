@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+enum startup_event
+{
+	startup_event_main,
+	startup_event_window_created,
+	startup_event_first_paint,
+	startup_event_interactive,
+	startup_event_count,
+};
+
+//Only the first time an event happens is kept
+void mark_startup_event(startup_event event);
+bool is_startup_event_marked(startup_event event);
+std::string format_startup_trace();
@@ -0,0 +1,161 @@
+#include "thread_pool.hpp"
+
+pool_task::~pool_task()
+{
+}
+
+scoped_lock::scoped_lock(CRITICAL_SECTION & section):
+	section(section)
+{
+	EnterCriticalSection(&section);
+}
+
+scoped_lock::~scoped_lock()
+{
+	LeaveCriticalSection(&section);
+}
+
+thread_pool::thread_pool(unsigned worker_count):
+	pending_tasks(0),
+	stopping(0),
+	next_queue(0)
+{
+	if(worker_count == 0)
+		worker_count = 1;
+	work_semaphore = CreateSemaphore(0, 0, 0x7fffffff, 0);
+	InitializeCriticalSection(&idle_lock);
+	idle_event = CreateEvent(0, TRUE, TRUE, 0);
+
+	queues.resize(worker_count);
+	contexts.resize(worker_count);
+	for(unsigned i = 0; i < worker_count; i++)
+	{
+		queues[i] = new worker_queue;
+		InitializeCriticalSection(&queues[i]->lock);
+		contexts[i].pool = this;
+		contexts[i].index = i;
+	}
+	for(unsigned i = 0; i < worker_count; i++)
+		threads.push_back(CreateThread(0, 0, &worker_entry, &contexts[i], 0, 0));
+}
+
+thread_pool::~thread_pool()
+{
+	//Tasks which have not started yet are discarded, running ones are waited for
+	InterlockedExchange(&stopping, 1);
+	ReleaseSemaphore(work_semaphore, static_cast<LONG>(threads.size()), 0);
+	for(std::vector<HANDLE>::iterator i = threads.begin(), end = threads.end(); i != end; i++)
+	{
+		WaitForSingleObject(*i, INFINITE);
+		CloseHandle(*i);
+	}
+
+	for(std::vector<worker_queue *>::iterator i = queues.begin(), end = queues.end(); i != end; i++)
+	{
+		worker_queue * queue = *i;
+		for(std::deque<pool_task *>::iterator j = queue->tasks.begin(), tasks_end = queue->tasks.end(); j != tasks_end; j++)
+			delete *j;
+		DeleteCriticalSection(&queue->lock);
+		delete queue;
+	}
+
+	CloseHandle(work_semaphore);
+	CloseHandle(idle_event);
+	DeleteCriticalSection(&idle_lock);
+}
+
+void thread_pool::submit(pool_task * task)
+{
+	unsigned worker = static_cast<unsigned>(InterlockedIncrement(&next_queue)) % queues.size();
+	submit(task, worker);
+}
+
+void thread_pool::submit(pool_task * task, unsigned worker)
+{
+	{
+		scoped_lock lock(idle_lock);
+		if(InterlockedIncrement(&pending_tasks) == 1)
+			ResetEvent(idle_event);
+	}
+	{
+		scoped_lock lock(queues[worker]->lock);
+		queues[worker]->tasks.push_back(task);
+	}
+	ReleaseSemaphore(work_semaphore, 1, 0);
+}
+
+bool thread_pool::is_idle() const
+{
+	return pending_tasks == 0;
+}
+
+void thread_pool::wait()
+{
+	WaitForSingleObject(idle_event, INFINITE);
+}
+
+unsigned thread_pool::get_worker_count() const
+{
+	return static_cast<unsigned>(queues.size());
+}
+
+unsigned thread_pool::get_processor_count()
+{
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	return static_cast<unsigned>(system_info.dwNumberOfProcessors);
+}
+
+DWORD WINAPI thread_pool::worker_entry(LPVOID parameter)
+{
+	worker_context * context = static_cast<worker_context *>(parameter);
+	context->pool->work(context->index);
+	return 0;
+}
+
+void thread_pool::work(unsigned worker)
+{
+	while(true)
+	{
+		//Every signal of the semaphore corresponds to exactly one queued task
+		WaitForSingleObject(work_semaphore, INFINITE);
+		if(stopping)
+			return;
+		pool_task * task = take_task(worker);
+		task->run(*this, worker);
+		delete task;
+		scoped_lock lock(idle_lock);
+		if(InterlockedDecrement(&pending_tasks) == 0)
+			SetEvent(idle_event);
+	}
+}
+
+pool_task * thread_pool::take_task(unsigned worker)
+{
+	std::size_t queue_count = queues.size();
+	while(true)
+	{
+		{
+			worker_queue & own_queue = *queues[worker];
+			scoped_lock lock(own_queue.lock);
+			if(!own_queue.tasks.empty())
+			{
+				pool_task * task = own_queue.tasks.back();
+				own_queue.tasks.pop_back();
+				return task;
+			}
+		}
+
+		for(std::size_t i = 1; i < queue_count; i++)
+		{
+			worker_queue & victim = *queues[(worker + i) % queue_count];
+			scoped_lock lock(victim.lock);
+			if(!victim.tasks.empty())
+			{
+				pool_task * task = victim.tasks.front();
+				victim.tasks.pop_front();
+				return task;
+			}
+		}
+	}
+}
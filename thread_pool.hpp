@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <windows.h>
+
+class thread_pool;
+
+class pool_task
+{
+public:
+	virtual ~pool_task();
+	//Runs on the given worker, tasks submitted to that worker from here are queued next to this one
+	virtual void run(thread_pool & pool, unsigned worker) = 0;
+};
+
+class scoped_lock
+{
+public:
+	scoped_lock(CRITICAL_SECTION & section);
+	~scoped_lock();
+
+private:
+	CRITICAL_SECTION & section;
+};
+
+//Every worker has its own deque of tasks. It takes the newest task from the back of its own deque and steals the oldest
+//tasks from the front of the other deques once it runs out, so that the large subtrees of recursive work get distributed.
+class thread_pool
+{
+public:
+	thread_pool(unsigned worker_count);
+	~thread_pool();
+
+	void submit(pool_task * task);
+	void submit(pool_task * task, unsigned worker);
+
+	//True when all submitted tasks have finished running
+	bool is_idle() const;
+	void wait();
+	unsigned get_worker_count() const;
+
+	static unsigned get_processor_count();
+
+private:
+	struct worker_queue
+	{
+		CRITICAL_SECTION lock;
+		std::deque<pool_task *> tasks;
+	};
+
+	struct worker_context
+	{
+		thread_pool * pool;
+		unsigned index;
+	};
+
+	std::vector<worker_queue *> queues;
+	std::vector<worker_context> contexts;
+	std::vector<HANDLE> threads;
+
+	HANDLE work_semaphore;
+	//The count is changed together with the event under the lock so that the event is set exactly when no task is pending
+	CRITICAL_SECTION idle_lock;
+	HANDLE idle_event;
+	LONG volatile pending_tasks;
+	LONG volatile stopping;
+	LONG volatile next_queue;
+
+	static DWORD WINAPI worker_entry(LPVOID parameter);
+	void work(unsigned worker);
+	pool_task * take_task(unsigned worker);
+};
@@ -0,0 +1,19 @@
+#include "timing.hpp"
+
+#include <windows.h>
+
+unsigned long long get_microseconds()
+{
+	static LONGLONG frequency = 0;
+	if(frequency == 0)
+	{
+		LARGE_INTEGER frequency_integer;
+		QueryPerformanceFrequency(&frequency_integer);
+		frequency = frequency_integer.QuadPart;
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	unsigned long long ticks = static_cast<unsigned long long>(counter.QuadPart);
+	unsigned long long unsigned_frequency = static_cast<unsigned long long>(frequency);
+	return ticks / unsigned_frequency * 1000000ull + ticks % unsigned_frequency * 1000000ull / unsigned_frequency;
+}
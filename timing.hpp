@@ -0,0 +1,3 @@
+#pragma once
+
+unsigned long long get_microseconds();
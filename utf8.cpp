@@ -0,0 +1,358 @@
+#include "utf8.hpp"
+
+#include "simd.hpp"
+
+namespace
+{
+	struct code_point_range
+	{
+		unsigned first;
+		unsigned last;
+	};
+
+	//Non-spacing marks, enclosing marks and format characters
+	code_point_range const combining_ranges[] =
+	{
+		{0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x05bf, 0x05bf}, {0x05c1, 0x05c2},
+		{0x05c4, 0x05c5}, {0x05c7, 0x05c7}, {0x0610, 0x061a}, {0x064b, 0x065f}, {0x0670, 0x0670},
+		{0x06d6, 0x06dc}, {0x06df, 0x06e4}, {0x06e7, 0x06e8}, {0x06ea, 0x06ed}, {0x0711, 0x0711},
+		{0x0730, 0x074a}, {0x07a6, 0x07b0}, {0x07eb, 0x07f3}, {0x0816, 0x0819}, {0x081b, 0x0823},
+		{0x0825, 0x0827}, {0x0829, 0x082d}, {0x0859, 0x085b}, {0x08d3, 0x08e1}, {0x08e3, 0x0902},
+		{0x093a, 0x093a}, {0x093c, 0x093c}, {0x0941, 0x0948}, {0x094d, 0x094d}, {0x0951, 0x0957},
+		{0x0962, 0x0963}, {0x0981, 0x0981}, {0x09bc, 0x09bc}, {0x09c1, 0x09c4}, {0x09cd, 0x09cd},
+		{0x09e2, 0x09e3}, {0x0a01, 0x0a02}, {0x0a3c, 0x0a3c}, {0x0a41, 0x0a42}, {0x0a47, 0x0a48},
+		{0x0a4b, 0x0a4d}, {0x0a70, 0x0a71}, {0x0a81, 0x0a82}, {0x0abc, 0x0abc}, {0x0ac1, 0x0ac5},
+		{0x0ac7, 0x0ac8}, {0x0acd, 0x0acd}, {0x0b01, 0x0b01}, {0x0b3c, 0x0b3c}, {0x0b3f, 0x0b3f},
+		{0x0b41, 0x0b44}, {0x0b4d, 0x0b4d}, {0x0b56, 0x0b56}, {0x0b82, 0x0b82}, {0x0bc0, 0x0bc0},
+		{0x0bcd, 0x0bcd}, {0x0c3e, 0x0c40}, {0x0c46, 0x0c48}, {0x0c4a, 0x0c4d}, {0x0c55, 0x0c56},
+		{0x0cbc, 0x0cbc}, {0x0cbf, 0x0cbf}, {0x0cc6, 0x0cc6}, {0x0ccc, 0x0ccd}, {0x0d41, 0x0d44},
+		{0x0d4d, 0x0d4d}, {0x0dca, 0x0dca}, {0x0dd2, 0x0dd4}, {0x0dd6, 0x0dd6}, {0x0e31, 0x0e31},
+		{0x0e34, 0x0e3a}, {0x0e47, 0x0e4e}, {0x0eb1, 0x0eb1}, {0x0eb4, 0x0ebc}, {0x0ec8, 0x0ecd},
+		{0x0f18, 0x0f19}, {0x0f35, 0x0f35}, {0x0f37, 0x0f37}, {0x0f39, 0x0f39}, {0x0f71, 0x0f7e},
+		{0x0f80, 0x0f84}, {0x0f86, 0x0f87}, {0x0f8d, 0x0fbc}, {0x0fc6, 0x0fc6}, {0x102d, 0x1030},
+		{0x1032, 0x1037}, {0x1039, 0x103a}, {0x1058, 0x1059}, {0x1160, 0x11ff}, {0x135d, 0x135f},
+		{0x1712, 0x1714}, {0x1732, 0x1734}, {0x1752, 0x1753}, {0x1772, 0x1773}, {0x17b4, 0x17b5},
+		{0x17b7, 0x17bd}, {0x17c6, 0x17c6}, {0x17c9, 0x17d3}, {0x17dd, 0x17dd}, {0x180b, 0x180e},
+		{0x18a9, 0x18a9}, {0x1920, 0x1922}, {0x1927, 0x1928}, {0x1932, 0x1932}, {0x1939, 0x193b},
+		{0x1a17, 0x1a18}, {0x1ab0, 0x1aff}, {0x1b00, 0x1b03}, {0x1b34, 0x1b34}, {0x1b36, 0x1b3a},
+		{0x1b3c, 0x1b3c}, {0x1b42, 0x1b42}, {0x1b6b, 0x1b73}, {0x1dc0, 0x1dff}, {0x200b, 0x200f},
+		{0x202a, 0x202e}, {0x2060, 0x2064}, {0x20d0, 0x20f0}, {0x302a, 0x302d}, {0x3099, 0x309a},
+		{0xa66f, 0xa672}, {0xa674, 0xa67d}, {0xa69e, 0xa69f}, {0xa6f0, 0xa6f1}, {0xa802, 0xa802},
+		{0xa806, 0xa806}, {0xa80b, 0xa80b}, {0xa825, 0xa826}, {0xa8c4, 0xa8c5}, {0xa8e0, 0xa8f1},
+		{0xfb1e, 0xfb1e}, {0xfe00, 0xfe0f}, {0xfe20, 0xfe2f}, {0xfeff, 0xfeff}, {0xfff9, 0xfffb},
+		{0x101fd, 0x101fd}, {0x10a01, 0x10a03}, {0x10a05, 0x10a06}, {0x10a0c, 0x10a0f}, {0x10a38, 0x10a3a},
+		{0x10a3f, 0x10a3f}, {0x1d167, 0x1d169}, {0x1d173, 0x1d182}, {0x1d185, 0x1d18b}, {0x1d1aa, 0x1d1ad},
+		{0x1d242, 0x1d244}, {0x1f3fb, 0x1f3ff}, {0xe0001, 0xe0001}, {0xe0020, 0xe007f}, {0xe0100, 0xe01ef},
+	};
+
+	//East Asian wide and fullwidth characters
+	code_point_range const wide_ranges[] =
+	{
+		{0x1100, 0x115f}, {0x231a, 0x231b}, {0x2329, 0x232a}, {0x23e9, 0x23ec}, {0x23f0, 0x23f0},
+		{0x23f3, 0x23f3}, {0x25fd, 0x25fe}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267f, 0x267f},
+		{0x2693, 0x2693}, {0x26a1, 0x26a1}, {0x26aa, 0x26ab}, {0x26bd, 0x26be}, {0x26c4, 0x26c5},
+		{0x26ce, 0x26ce}, {0x26d4, 0x26d4}, {0x26ea, 0x26ea}, {0x26f2, 0x26f3}, {0x26f5, 0x26f5},
+		{0x26fa, 0x26fa}, {0x26fd, 0x26fd}, {0x2705, 0x2705}, {0x270a, 0x270b}, {0x2728, 0x2728},
+		{0x274c, 0x274c}, {0x274e, 0x274e}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+		{0x27b0, 0x27b0}, {0x27bf, 0x27bf}, {0x2b1b, 0x2b1c}, {0x2b50, 0x2b50}, {0x2b55, 0x2b55},
+		{0x2e80, 0x303e}, {0x3041, 0x33ff}, {0x3400, 0x4dbf}, {0x4e00, 0x9fff}, {0xa000, 0xa4cf},
+		{0xa960, 0xa97f}, {0xac00, 0xd7a3}, {0xf900, 0xfaff}, {0xfe10, 0xfe19}, {0xfe30, 0xfe6f},
+		{0xff00, 0xff60}, {0xffe0, 0xffe6}, {0x16fe0, 0x16fe4}, {0x17000, 0x18aff}, {0x1b000, 0x1b2ff},
+		{0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf}, {0x1f18e, 0x1f18e}, {0x1f191, 0x1f19a}, {0x1f200, 0x1f251},
+		{0x1f300, 0x1f64f}, {0x1f680, 0x1f6ff}, {0x1f7e0, 0x1f7eb}, {0x1f90c, 0x1f9ff}, {0x1fa70, 0x1faff},
+		{0x20000, 0x2fffd}, {0x30000, 0x3fffd},
+	};
+
+	template<std::size_t size>
+	bool is_in_table(unsigned code_point, code_point_range const (& table)[size])
+	{
+		if(code_point < table[0].first || code_point > table[size - 1].last)
+			return false;
+		std::size_t lower = 0;
+		std::size_t upper = size;
+		while(lower < upper)
+		{
+			std::size_t middle = lower + (upper - lower) / 2;
+			if(code_point > table[middle].last)
+				lower = middle + 1;
+			else if(code_point < table[middle].first)
+				upper = middle;
+			else
+				return true;
+		}
+		return false;
+	}
+
+}
+
+namespace utf8
+{
+	unsigned decode(char const * data, std::size_t length, std::size_t & offset)
+	{
+		unsigned char lead = static_cast<unsigned char>(data[offset]);
+		if(lead < 0x80)
+		{
+			offset++;
+			return lead;
+		}
+
+		std::size_t sequence_length;
+		unsigned code_point;
+		unsigned minimum;
+		if((lead & 0xe0) == 0xc0)
+		{
+			sequence_length = 2;
+			code_point = lead & 0x1f;
+			minimum = 0x80;
+		}
+		else if((lead & 0xf0) == 0xe0)
+		{
+			sequence_length = 3;
+			code_point = lead & 0x0f;
+			minimum = 0x800;
+		}
+		else if((lead & 0xf8) == 0xf0)
+		{
+			sequence_length = 4;
+			code_point = lead & 0x07;
+			minimum = 0x10000;
+		}
+		else
+		{
+			offset++;
+			return replacement_character;
+		}
+
+		if(offset + sequence_length > length)
+		{
+			offset++;
+			return replacement_character;
+		}
+
+		for(std::size_t i = 1; i < sequence_length; i++)
+		{
+			char byte = data[offset + i];
+			if(!is_continuation_byte(byte))
+			{
+				offset++;
+				return replacement_character;
+			}
+			code_point = (code_point << 6) | (static_cast<unsigned char>(byte) & 0x3f);
+		}
+
+		if(code_point < minimum || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff))
+		{
+			offset++;
+			return replacement_character;
+		}
+
+		offset += sequence_length;
+		return code_point;
+	}
+
+	void encode(unsigned code_point, std::string & output)
+	{
+		if(code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff))
+			code_point = replacement_character;
+
+		if(code_point < 0x80)
+			output.push_back(static_cast<char>(code_point));
+		else if(code_point < 0x800)
+		{
+			output.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+		else if(code_point < 0x10000)
+		{
+			output.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+		else
+		{
+			output.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+	}
+
+	unsigned get_character_width(unsigned code_point)
+	{
+		if(code_point < 0x300)
+			return 1;
+		if(is_in_table(code_point, combining_ranges))
+			return 0;
+		if(is_in_table(code_point, wide_ranges))
+			return 2;
+		return 1;
+	}
+
+	std::size_t get_ascii_length(char const * data, std::size_t length)
+	{
+		std::size_t offset = 0;
+#ifdef SIMD_SSE2
+		for(; offset + 16 <= length; offset += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(block));
+			if(mask != 0)
+				return offset + simd::count_trailing_zeros(mask);
+		}
+#endif
+		for(; offset < length; offset++)
+		{
+			if(static_cast<unsigned char>(data[offset]) >= 0x80)
+				break;
+		}
+		return offset;
+	}
+
+	bool is_ascii(std::string const & text)
+	{
+		return get_ascii_length(text.c_str(), text.length()) == text.length();
+	}
+
+	void lower_ascii(char const * data, std::size_t length, char * output)
+	{
+		std::size_t offset = 0;
+#ifdef SIMD_SSE2
+		//The signed comparisons leave the bytes of multi byte characters alone since they are all negative
+		__m128i const before_upper = _mm_set1_epi8('A' - 1);
+		__m128i const after_upper = _mm_set1_epi8('Z' + 1);
+		__m128i const case_bit = _mm_set1_epi8(0x20);
+		for(; offset + 16 <= length; offset += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset));
+			__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, before_upper), _mm_cmplt_epi8(block, after_upper));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output + offset), _mm_or_si128(block, _mm_and_si128(upper, case_bit)));
+		}
+#endif
+		for(; offset < length; offset++)
+			output[offset] = lower_ascii(data[offset]);
+	}
+
+	unsigned get_width(char const * data, std::size_t length)
+	{
+		unsigned width = 0;
+		std::size_t offset = 0;
+		while(offset < length)
+		{
+			std::size_t ascii_length = get_ascii_length(data + offset, length - offset);
+			width += static_cast<unsigned>(ascii_length);
+			offset += ascii_length;
+			if(offset < length)
+				width += get_character_width(decode(data, length, offset));
+		}
+		return width;
+	}
+
+	unsigned get_width(std::string const & text)
+	{
+		return get_width(text.c_str(), text.length());
+	}
+
+	std::size_t fit_columns(char const * data, std::size_t length, unsigned & columns)
+	{
+		unsigned remaining = columns;
+		std::size_t offset = 0;
+		while(offset < length)
+		{
+			std::size_t ascii_length = get_ascii_length(data + offset, length - offset);
+			if(ascii_length > remaining)
+			{
+				offset += remaining;
+				remaining = 0;
+				break;
+			}
+			offset += ascii_length;
+			remaining -= static_cast<unsigned>(ascii_length);
+			if(offset == length)
+				break;
+
+			std::size_t next_offset = offset;
+			unsigned width = get_character_width(decode(data, length, next_offset));
+			if(width > remaining)
+				break;
+			remaining -= width;
+			offset = next_offset;
+		}
+		columns -= remaining;
+		return offset;
+	}
+
+	std::size_t next_character(std::string const & text, std::size_t offset)
+	{
+		char const * data = text.c_str();
+		std::size_t length = text.length();
+		if(offset >= length)
+			return length;
+		decode(data, length, offset);
+		while(offset < length)
+		{
+			std::size_t next_offset = offset;
+			if(get_character_width(decode(data, length, next_offset)) != 0)
+				break;
+			offset = next_offset;
+		}
+		return offset;
+	}
+
+	std::size_t previous_character(std::string const & text, std::size_t offset)
+	{
+		char const * data = text.c_str();
+		std::size_t length = text.length();
+		while(offset > 0)
+		{
+			offset--;
+			while(offset > 0 && is_continuation_byte(data[offset]))
+				offset--;
+			std::size_t next_offset = offset;
+			if(get_character_width(decode(data, length, next_offset)) != 0)
+				break;
+		}
+		return offset;
+	}
+
+	std::wstring to_wide(std::string const & text)
+	{
+		std::wstring output;
+		output.reserve(text.length());
+		char const * data = text.c_str();
+		std::size_t length = text.length();
+		for(std::size_t offset = 0; offset < length;)
+		{
+			unsigned code_point = decode(data, length, offset);
+			if(code_point >= 0x10000 && sizeof(wchar_t) == 2)
+			{
+				code_point -= 0x10000;
+				output.push_back(static_cast<wchar_t>(0xd800 | (code_point >> 10)));
+				output.push_back(static_cast<wchar_t>(0xdc00 | (code_point & 0x3ff)));
+			}
+			else
+				output.push_back(static_cast<wchar_t>(code_point));
+		}
+		return output;
+	}
+
+	std::string from_wide(std::wstring const & text)
+	{
+		return from_wide(text.c_str());
+	}
+
+	std::string from_wide(wchar_t const * text)
+	{
+		std::string output;
+		for(; *text != 0; text++)
+		{
+			unsigned code_point = static_cast<unsigned>(*text);
+			if(code_point >= 0xd800 && code_point <= 0xdbff && text[1] >= 0xdc00 && text[1] <= 0xdfff)
+			{
+				text++;
+				code_point = 0x10000 + ((code_point - 0xd800) << 10) + (static_cast<unsigned>(*text) - 0xdc00);
+			}
+			encode(code_point, output);
+		}
+		return output;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+namespace utf8
+{
+	unsigned const replacement_character = 0xfffd;
+
+	//Decodes the code point at offset and advances offset past it, malformed input yields the replacement character and skips one byte
+	unsigned decode(char const * data, std::size_t length, std::size_t & offset);
+	void encode(unsigned code_point, std::string & output);
+
+	//Number of terminal columns occupied by a code point, 0 for combining characters and 2 for East Asian wide characters
+	unsigned get_character_width(unsigned code_point);
+
+	//Length of the run of ASCII bytes at the start of data
+	std::size_t get_ascii_length(char const * data, std::size_t length);
+	bool is_ascii(std::string const & text);
+
+	inline bool is_continuation_byte(char byte)
+	{
+		return (static_cast<unsigned char>(byte) & 0xc0) == 0x80;
+	}
+
+	//Only ASCII letters are lowered, the bytes of multi byte characters are left alone
+	inline char lower_ascii(char character)
+	{
+		return character >= 'A' && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+	}
+
+	void lower_ascii(char const * data, std::size_t length, char * output);
+
+	unsigned get_width(char const * data, std::size_t length);
+	unsigned get_width(std::string const & text);
+
+	//Returns the number of bytes of the longest prefix which fits into the given number of columns, columns receives the width of that prefix
+	std::size_t fit_columns(char const * data, std::size_t length, unsigned & columns);
+
+	//Offsets of neighbouring characters, combining characters are kept together with the character they modify
+	std::size_t next_character(std::string const & text, std::size_t offset);
+	std::size_t previous_character(std::string const & text, std::size_t offset);
+
+	std::wstring to_wide(std::string const & text);
+	std::string from_wide(std::wstring const & text);
+	std::string from_wide(wchar_t const * text);
+}
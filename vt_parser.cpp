@@ -0,0 +1,557 @@
+#include "vt_parser.hpp"
+
+#include <algorithm>
+
+#include "utf8.hpp"
+#include "simd.hpp"
+
+namespace
+{
+	char const escape = '\x1b';
+	std::size_t const parameter_limit = 32;
+	unsigned const parameter_value_limit = 0xffff;
+
+	COLORREF const basic_palette[] =
+	{
+		RGB(0, 0, 0),
+		RGB(205, 0, 0),
+		RGB(0, 205, 0),
+		RGB(205, 205, 0),
+		RGB(0, 0, 238),
+		RGB(205, 0, 205),
+		RGB(0, 205, 205),
+		RGB(229, 229, 229),
+		RGB(127, 127, 127),
+		RGB(255, 0, 0),
+		RGB(0, 255, 0),
+		RGB(255, 255, 0),
+		RGB(92, 92, 255),
+		RGB(255, 0, 255),
+		RGB(0, 255, 255),
+		RGB(255, 255, 255),
+	};
+
+	COLORREF get_palette_colour(unsigned index)
+	{
+		if(index < 16)
+			return basic_palette[index];
+		else if(index < 232)
+		{
+			index -= 16;
+			unsigned const levels[] = {0, 95, 135, 175, 215, 255};
+			return RGB(levels[index / 36], levels[index / 6 % 6], levels[index % 6]);
+		}
+		else
+		{
+			unsigned level = 8 + 10 * (std::min(index, 255u) - 232);
+			return RGB(level, level, level);
+		}
+	}
+
+	bool is_span_before(attribute_span const & span, std::size_t offset)
+	{
+		return span.offset < offset;
+	}
+
+	bool is_plain_byte(unsigned char byte)
+	{
+		return byte >= ' ' || byte == '\n' || byte == '\t';
+	}
+}
+
+text_attribute::text_attribute():
+	foreground(default_colour),
+	background(default_colour),
+	flags(0)
+{
+}
+
+bool text_attribute::operator==(text_attribute const & other) const
+{
+	return foreground == other.foreground && background == other.background && flags == other.flags;
+}
+
+bool text_attribute::operator!=(text_attribute const & other) const
+{
+	return !(*this == other);
+}
+
+bool text_attribute::is_default() const
+{
+	return *this == text_attribute();
+}
+
+std::vector<attribute_span>::const_iterator find_attribute_span(std::vector<attribute_span> const & spans, std::size_t offset)
+{
+	//Last span starting at or before the offset, or end if the offset precedes all spans
+	std::size_t lower = 0;
+	std::size_t upper = spans.size();
+	while(lower < upper)
+	{
+		std::size_t middle = lower + (upper - lower) / 2;
+		if(spans[middle].offset <= offset)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	if(lower == 0)
+		return spans.end();
+	return spans.begin() + (lower - 1);
+}
+
+text_attribute const & get_attribute(std::vector<attribute_span> const & spans, std::size_t offset)
+{
+	static text_attribute const default_attribute;
+	std::vector<attribute_span>::const_iterator span = find_attribute_span(spans, offset);
+	if(span == spans.end())
+		return default_attribute;
+	return span->attribute;
+}
+
+void truncate_attribute_spans(std::vector<attribute_span> & spans, std::size_t length)
+{
+	while(!spans.empty() && spans.back().offset >= length)
+		spans.pop_back();
+}
+
+std::size_t find_control_byte(char const * data, std::size_t length)
+{
+	std::size_t offset = 0;
+#ifdef SIMD_SSE2
+	__m128i const control_limit = _mm_set1_epi8(0x1f);
+	__m128i const newline = _mm_set1_epi8('\n');
+	__m128i const tab = _mm_set1_epi8('\t');
+	for(; offset + 16 <= length; offset += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + offset));
+		__m128i control = _mm_cmpeq_epi8(_mm_min_epu8(block, control_limit), block);
+		__m128i allowed = _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, tab));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_andnot_si128(allowed, control)));
+		if(mask != 0)
+			return offset + simd::count_trailing_zeros(mask);
+	}
+#endif
+	for(; offset < length; offset++)
+	{
+		if(!is_plain_byte(static_cast<unsigned char>(data[offset])))
+			break;
+	}
+	return offset;
+}
+
+vt_parser::vt_parser():
+	state(state_ground),
+	private_sequence(false),
+	cursor_distance(0),
+	erased_offset(std::string::npos)
+{
+}
+
+void vt_parser::process(std::string const & input, std::string & text, std::vector<attribute_span> & spans)
+{
+	process(input.c_str(), input.length(), text, spans);
+}
+
+void vt_parser::process(char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans)
+{
+	std::size_t offset = 0;
+	while(offset < length)
+	{
+		char byte = data[offset];
+		switch(state)
+		{
+		case state_ground:
+		{
+			//Fast path: copy the entire run of printable bytes at once
+			std::size_t run_length = find_control_byte(data + offset, length - offset);
+			if(run_length > 0)
+			{
+				write_text(data + offset, run_length, text, spans);
+				offset += run_length;
+				continue;
+			}
+			process_control_byte(byte, text, spans);
+			break;
+		}
+
+		case state_escape:
+			if(byte == '[')
+			{
+				state = state_csi;
+				parameters.clear();
+				subparameters.clear();
+				private_sequence = false;
+			}
+			else if(byte == ']')
+				state = state_osc;
+			else if(byte >= ' ' && byte <= '/')
+				state = state_escape_intermediate;
+			else if(byte == 'c')
+			{
+				attribute = text_attribute();
+				state = state_ground;
+			}
+			else if(byte != escape)
+				state = state_ground;
+			break;
+
+		case state_escape_intermediate:
+			if(byte < ' ' || byte > '/')
+				state = state_ground;
+			break;
+
+		case state_csi:
+			if(byte >= '0' && byte <= '9')
+			{
+				if(parameters.empty())
+					add_parameter(false);
+				unsigned & parameter = parameters.back();
+				parameter = std::min(parameter * 10 + static_cast<unsigned>(byte - '0'), parameter_value_limit);
+			}
+			else if(byte == ';' || byte == ':')
+			{
+				if(parameters.empty())
+					add_parameter(false);
+				if(parameters.size() < parameter_limit)
+					add_parameter(byte == ':');
+			}
+			else if(byte >= '<' && byte <= '?')
+				private_sequence = true;
+			else if(byte >= '@' && byte <= '~')
+			{
+				if(!private_sequence)
+					dispatch_csi(byte, text, spans);
+				state = state_ground;
+			}
+			else if(byte == escape)
+				state = state_escape;
+			else if(byte == '\x18' || byte == '\x1a')
+				state = state_ground;
+			break;
+
+		case state_osc:
+			if(byte == '\a')
+				state = state_ground;
+			else if(byte == escape)
+				state = state_osc_escape;
+			break;
+
+		case state_osc_escape:
+			state = byte == '\\' ? state_ground : state_osc;
+			break;
+		}
+		offset++;
+	}
+}
+
+void vt_parser::reset()
+{
+	state = state_ground;
+	attribute = text_attribute();
+	parameters.clear();
+	subparameters.clear();
+	private_sequence = false;
+	cursor_distance = 0;
+}
+
+std::size_t vt_parser::take_erased_offset()
+{
+	std::size_t output = erased_offset;
+	erased_offset = std::string::npos;
+	return output;
+}
+
+void vt_parser::write_text(char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans)
+{
+	if(cursor_distance > 0)
+	{
+		//Text written after moving the cursor back overwrites as many columns of the line as it occupies, a newline moves the cursor to the end
+		std::size_t overwrite_length = static_cast<std::size_t>(std::find(data, data + length, '\n') - data);
+		if(overwrite_length > 0)
+		{
+			std::size_t cursor = get_cursor(text);
+			unsigned columns = utf8::get_width(data, overwrite_length);
+			unsigned covered_columns = columns;
+			std::size_t replaced_end = cursor + utf8::fit_columns(text.c_str() + cursor, text.length() - cursor, covered_columns);
+			//A wide character which is only partly covered is overwritten as a whole
+			if(covered_columns < columns && replaced_end < text.length())
+				replaced_end = utf8::next_character(text, replaced_end);
+			replace_text(cursor, replaced_end, data, overwrite_length, text, spans);
+			set_cursor(cursor + overwrite_length, text);
+			data += overwrite_length;
+			length -= overwrite_length;
+			if(length == 0)
+				return;
+		}
+		cursor_distance = 0;
+	}
+
+	text_attribute const & previous_attribute = get_attribute(spans, text.length());
+	if(attribute != previous_attribute)
+	{
+		if(!spans.empty() && spans.back().offset == text.length())
+		{
+			spans.pop_back();
+			if(attribute != get_attribute(spans, text.length()))
+			{
+				attribute_span span;
+				span.offset = text.length();
+				span.attribute = attribute;
+				spans.push_back(span);
+			}
+		}
+		else
+		{
+			attribute_span span;
+			span.offset = text.length();
+			span.attribute = attribute;
+			spans.push_back(span);
+		}
+	}
+
+	text.append(data, length);
+}
+
+void vt_parser::process_control_byte(char byte, std::string & text, std::vector<attribute_span> & spans)
+{
+	switch(byte)
+	{
+	case escape:
+		state = state_escape;
+		break;
+
+	case '\r':
+		set_cursor(get_line_offset(text), text);
+		break;
+
+	case '\b':
+		set_cursor(utf8::previous_character(text, get_cursor(text)), text);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void vt_parser::dispatch_csi(char final_byte, std::string & text, std::vector<attribute_span> & spans)
+{
+	std::size_t line_offset = get_line_offset(text);
+	std::size_t cursor = get_cursor(text);
+	switch(final_byte)
+	{
+	case 'm':
+		select_graphic_rendition();
+		break;
+
+	case 'K':
+	case 'J':
+		//Erase in display is mapped onto the last line like erase in line, the scrollback above it holds the output of earlier commands and
+		//is never erased. Mode 3 only erases the saved lines of a terminal and is dropped.
+		switch(get_parameter(0, 0))
+		{
+		case 0:
+			erase_text(cursor, text, spans);
+			break;
+
+		case 1:
+		{
+			//The character under the cursor is erased as well, the cursor stays in its column
+			std::size_t end = cursor < text.length() ? utf8::next_character(text, cursor) : cursor;
+			std::string blanks(utf8::get_width(text.c_str() + line_offset, end - line_offset), ' ');
+			std::size_t cursor_column = utf8::get_width(text.c_str() + line_offset, cursor - line_offset);
+			replace_text(line_offset, end, blanks.c_str(), blanks.length(), text, spans);
+			set_cursor(line_offset + cursor_column, text);
+			break;
+		}
+
+		case 2:
+			erase_text(line_offset, text, spans);
+			break;
+		}
+		break;
+
+	case 'D':
+		for(unsigned i = std::max(get_parameter(0, 1), 1u); i > 0 && cursor > line_offset; i--)
+			cursor = utf8::previous_character(text, cursor);
+		set_cursor(cursor, text);
+		break;
+
+	case 'C':
+		for(unsigned i = std::max(get_parameter(0, 1), 1u); i > 0 && cursor < text.length(); i--)
+			cursor = utf8::next_character(text, cursor);
+		set_cursor(cursor, text);
+		break;
+
+	case 'G':
+		cursor = line_offset;
+		for(unsigned i = std::max(get_parameter(0, 1), 1u); i > 1 && cursor < text.length(); i--)
+			cursor = utf8::next_character(text, cursor);
+		set_cursor(cursor, text);
+		break;
+
+	default:
+		//Other cursor movement has no meaning in an append only scrollback and is dropped
+		break;
+	}
+}
+
+void vt_parser::select_graphic_rendition()
+{
+	if(parameters.empty())
+		add_parameter(false);
+
+	for(std::size_t i = 0; i < parameters.size(); i++)
+	{
+		unsigned parameter = parameters[i];
+		std::size_t group_end = get_group_end(i);
+		if(group_end > i + 1)
+		{
+			//Subparameters never act as codes of their own. 38:5:n and 38:2:cs:r:g:b select colours, the colour space id may be
+			//empty or left out. 4:0 turns underlining off and the other underline styles are drawn as a plain underline.
+			if(parameter == 38 || parameter == 48)
+			{
+				COLORREF & colour = parameter == 38 ? attribute.foreground : attribute.background;
+				unsigned mode = parameters[i + 1];
+				std::size_t values = group_end - i - 2;
+				if(mode == 5 && values >= 1)
+					colour = get_palette_colour(parameters[i + 2]);
+				else if(mode == 2 && values >= 3)
+				{
+					std::size_t red = values >= 4 ? i + 3 : i + 2;
+					colour = RGB(std::min(parameters[red], 255u), std::min(parameters[red + 1], 255u), std::min(parameters[red + 2], 255u));
+				}
+			}
+			else if(parameter == 4)
+			{
+				if(parameters[i + 1] == 0)
+					attribute.flags &= ~text_flag_underline;
+				else
+					attribute.flags |= text_flag_underline;
+			}
+			i = group_end - 1;
+		}
+		else if(parameter == 0)
+			attribute = text_attribute();
+		else if(parameter == 1)
+			attribute.flags |= text_flag_bold;
+		else if(parameter == 4)
+			attribute.flags |= text_flag_underline;
+		else if(parameter == 7)
+			attribute.flags |= text_flag_inverse;
+		else if(parameter == 22)
+			attribute.flags &= ~text_flag_bold;
+		else if(parameter == 24)
+			attribute.flags &= ~text_flag_underline;
+		else if(parameter == 27)
+			attribute.flags &= ~text_flag_inverse;
+		else if(parameter >= 30 && parameter <= 37)
+			attribute.foreground = get_palette_colour(parameter - 30);
+		else if(parameter == 39)
+			attribute.foreground = default_colour;
+		else if(parameter >= 40 && parameter <= 47)
+			attribute.background = get_palette_colour(parameter - 40);
+		else if(parameter == 49)
+			attribute.background = default_colour;
+		else if(parameter >= 90 && parameter <= 97)
+			attribute.foreground = get_palette_colour(parameter - 90 + 8);
+		else if(parameter >= 100 && parameter <= 107)
+			attribute.background = get_palette_colour(parameter - 100 + 8);
+		else if(parameter == 38 || parameter == 48)
+		{
+			COLORREF & colour = parameter == 38 ? attribute.foreground : attribute.background;
+			unsigned mode = get_parameter(i + 1, 0);
+			if(mode == 5 && i + 2 < parameters.size())
+			{
+				colour = get_palette_colour(parameters[i + 2]);
+				i += 2;
+			}
+			else if(mode == 2 && i + 4 < parameters.size())
+			{
+				colour = RGB(std::min(parameters[i + 2], 255u), std::min(parameters[i + 3], 255u), std::min(parameters[i + 4], 255u));
+				i += 4;
+			}
+			else
+				break;
+		}
+	}
+}
+
+void vt_parser::erase_text(std::size_t offset, std::string & text, std::vector<attribute_span> & spans)
+{
+	if(offset >= text.length())
+		return;
+	text.erase(offset);
+	truncate_attribute_spans(spans, offset);
+	erased_offset = std::min(erased_offset, offset);
+	cursor_distance = 0;
+}
+
+void vt_parser::replace_text(std::size_t begin, std::size_t end, char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans)
+{
+	text_attribute preceding_attribute = begin > 0 ? get_attribute(spans, begin - 1) : text_attribute();
+	text_attribute following_attribute = get_attribute(spans, end);
+	bool text_follows = end < text.length();
+
+	std::vector<attribute_span>::iterator first = std::lower_bound(spans.begin(), spans.end(), begin, is_span_before);
+	first = spans.erase(first, std::lower_bound(first, spans.end(), end + 1, is_span_before));
+	for(std::vector<attribute_span>::iterator i = first; i != spans.end(); i++)
+		i->offset = i->offset - (end - begin) + length;
+
+	attribute_span span;
+	if(text_follows && following_attribute != attribute)
+	{
+		span.offset = begin + length;
+		span.attribute = following_attribute;
+		first = spans.insert(first, span);
+	}
+	if(length > 0 && attribute != preceding_attribute)
+	{
+		span.offset = begin;
+		span.attribute = attribute;
+		spans.insert(first, span);
+	}
+
+	text.replace(begin, end - begin, data, length);
+	erased_offset = std::min(erased_offset, begin);
+}
+
+unsigned vt_parser::get_parameter(std::size_t index, unsigned default_value) const
+{
+	if(index >= parameters.size())
+		return default_value;
+	return parameters[index];
+}
+
+std::size_t vt_parser::get_group_end(std::size_t index) const
+{
+	index++;
+	while(index < parameters.size() && subparameters[index])
+		index++;
+	return index;
+}
+
+void vt_parser::add_parameter(bool subparameter)
+{
+	parameters.push_back(0);
+	subparameters.push_back(subparameter);
+}
+
+std::size_t vt_parser::get_line_offset(std::string const & text) const
+{
+	std::size_t newline_offset = text.rfind('\n');
+	if(newline_offset == std::string::npos)
+		return 0;
+	return newline_offset + 1;
+}
+
+std::size_t vt_parser::get_cursor(std::string const & text) const
+{
+	return text.length() - std::min(cursor_distance, text.length() - get_line_offset(text));
+}
+
+void vt_parser::set_cursor(std::size_t cursor, std::string const & text)
+{
+	cursor = std::max(cursor, get_line_offset(text));
+	cursor = std::min(cursor, text.length());
+	cursor_distance = text.length() - cursor;
+}
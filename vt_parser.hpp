@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+enum text_flag
+{
+	text_flag_bold = 1,
+	text_flag_underline = 2,
+	text_flag_inverse = 4,
+};
+
+//Colours set to default_colour are rendered with the colours of the console
+COLORREF const default_colour = 0xffffffff;
+
+struct text_attribute
+{
+	COLORREF foreground;
+	COLORREF background;
+	unsigned flags;
+
+	text_attribute();
+	bool operator==(text_attribute const & other) const;
+	bool operator!=(text_attribute const & other) const;
+	bool is_default() const;
+};
+
+//A span applies to all bytes from its offset up to the offset of the next span
+struct attribute_span
+{
+	std::size_t offset;
+	text_attribute attribute;
+};
+
+text_attribute const & get_attribute(std::vector<attribute_span> const & spans, std::size_t offset);
+std::vector<attribute_span>::const_iterator find_attribute_span(std::vector<attribute_span> const & spans, std::size_t offset);
+void truncate_attribute_spans(std::vector<attribute_span> & spans, std::size_t length);
+
+//Returns the length of the run of bytes at the start of data which require no escape processing
+std::size_t find_control_byte(char const * data, std::size_t length);
+
+class vt_parser
+{
+public:
+	vt_parser();
+
+	void process(std::string const & input, std::string & text, std::vector<attribute_span> & spans);
+	void process(char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans);
+	void reset();
+
+	//Lowest offset of the text which has been erased or replaced since the last call, npos if there was none
+	std::size_t take_erased_offset();
+
+private:
+	enum parser_state
+	{
+		state_ground,
+		state_escape,
+		state_escape_intermediate,
+		state_csi,
+		state_osc,
+		state_osc_escape,
+	};
+
+	parser_state state;
+	text_attribute attribute;
+
+	std::vector<unsigned> parameters;
+	//Set for the parameters which follow a colon, they are subparameters in the group of the parameter before them
+	std::vector<bool> subparameters;
+	bool private_sequence;
+
+	//Number of bytes between the cursor and the end of the text, the cursor is always on the last line
+	std::size_t cursor_distance;
+
+	std::size_t erased_offset;
+
+	void write_text(char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans);
+	void process_control_byte(char byte, std::string & text, std::vector<attribute_span> & spans);
+	void dispatch_csi(char final_byte, std::string & text, std::vector<attribute_span> & spans);
+	void select_graphic_rendition();
+	void erase_text(std::size_t offset, std::string & text, std::vector<attribute_span> & spans);
+	//Replaces the bytes from begin to end with data in the current attribute, the spans of the text after them move along with it
+	void replace_text(std::size_t begin, std::size_t end, char const * data, std::size_t length, std::string & text, std::vector<attribute_span> & spans);
+
+	unsigned get_parameter(std::size_t index, unsigned default_value) const;
+	//Index following the last subparameter of the group which starts at the index
+	std::size_t get_group_end(std::size_t index) const;
+	void add_parameter(bool subparameter);
+	std::size_t get_line_offset(std::string const & text) const;
+	std::size_t get_cursor(std::string const & text) const;
+	void set_cursor(std::size_t cursor, std::string const & text);
+};
@@ -0,0 +1,295 @@
+#include "wrap_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "utf8.hpp"
+
+namespace
+{
+	std::size_t const no_anchor = static_cast<std::size_t>(-1);
+}
+
+unsigned count_rows(char const * data, std::size_t length, unsigned width)
+{
+	if(length == 0)
+		return 1;
+	if(utf8::get_ascii_length(data, length) == length)
+		return static_cast<unsigned>((length + width - 1) / width);
+
+	unsigned rows = 0;
+	std::size_t offset = 0;
+	while(offset < length)
+	{
+		unsigned columns = width;
+		std::size_t row_length = utf8::fit_columns(data + offset, length - offset, columns);
+		//A character wider than the entire line still has to be placed somewhere
+		if(row_length == 0)
+		{
+			std::size_t next_offset = offset;
+			utf8::decode(data, length, next_offset);
+			row_length = next_offset - offset;
+		}
+		offset += row_length;
+		rows++;
+	}
+	return rows;
+}
+
+void get_row_offsets(char const * data, std::size_t length, unsigned width, std::vector<std::size_t> & offsets)
+{
+	offsets.clear();
+	if(utf8::get_ascii_length(data, length) == length)
+	{
+		for(std::size_t offset = 0; offset < length || offset == 0; offset += width)
+			offsets.push_back(offset);
+		return;
+	}
+
+	std::size_t offset = 0;
+	do
+	{
+		offsets.push_back(offset);
+		unsigned columns = width;
+		std::size_t row_length = utf8::fit_columns(data + offset, length - offset, columns);
+		if(row_length == 0)
+		{
+			std::size_t next_offset = offset;
+			utf8::decode(data, length, next_offset);
+			row_length = next_offset - offset;
+		}
+		offset += row_length;
+	}
+	while(offset < length);
+}
+
+wrap_index::wrap_index():
+	width(1),
+	generation(0)
+{
+	clear();
+}
+
+void wrap_index::clear()
+{
+	lines.clear();
+	end = 0;
+	total_columns = 0;
+	exact_rows = 0;
+	stale_lines = 0;
+	stale_lines_base = 0;
+	stale_rows_estimate = 0;
+	reflow_cursor = 0;
+	anchor_line = no_anchor;
+}
+
+void wrap_index::truncate(std::size_t offset)
+{
+	while(!lines.empty() && end > offset)
+		remove_last_line();
+	reflow_cursor = std::min(reflow_cursor, lines.size());
+}
+
+void wrap_index::append(std::string const & text, std::size_t new_end)
+{
+	char const * data = text.c_str();
+	while(end < new_end)
+	{
+		char const * newline = static_cast<char const *>(std::memchr(data + end, '\n', new_end - end));
+		if(newline == 0)
+			break;
+		std::size_t length = static_cast<std::size_t>(newline - (data + end));
+
+		line_entry entry;
+		entry.offset = end;
+		entry.ascii = utf8::get_ascii_length(data + end, length) == length;
+		entry.columns = entry.ascii ? static_cast<unsigned>(length) : utf8::get_width(data + end, length);
+		entry.rows = count_rows(data + end, length, width);
+		entry.generation = generation;
+		lines.push_back(entry);
+
+		total_columns += entry.columns;
+		exact_rows += entry.rows;
+		if(anchor_line != no_anchor)
+			anchor_exact_rows += entry.rows;
+		end += length + 1;
+	}
+}
+
+void wrap_index::set_width(unsigned new_width)
+{
+	if(new_width == width)
+		return;
+
+	unsigned long long row_count = get_row_count();
+	unsigned old_width = width;
+	width = new_width;
+	generation++;
+
+	exact_rows = 0;
+	stale_lines = lines.size();
+	stale_lines_base = stale_lines;
+	stale_rows_estimate = row_count * old_width / new_width;
+	stale_rows_estimate = std::min<unsigned long long>(stale_rows_estimate, total_columns / new_width + stale_lines);
+	stale_rows_estimate = std::max<unsigned long long>(stale_rows_estimate, stale_lines);
+	reflow_cursor = lines.size();
+
+	//Every line is stale now, so the count after the anchor starts over without going through the lines
+	if(anchor_line != no_anchor)
+	{
+		anchor_exact_rows = 0;
+		anchor_stale_lines = lines.size() - 1 - anchor_line;
+	}
+}
+
+unsigned wrap_index::get_width() const
+{
+	return width;
+}
+
+std::size_t wrap_index::get_end() const
+{
+	return end;
+}
+
+std::size_t wrap_index::get_line_count() const
+{
+	return lines.size();
+}
+
+std::size_t wrap_index::get_line_begin(std::size_t line) const
+{
+	return lines[line].offset;
+}
+
+std::size_t wrap_index::get_line_end(std::size_t line) const
+{
+	std::size_t next_offset = line + 1 < lines.size() ? lines[line + 1].offset : end;
+	return next_offset - 1;
+}
+
+std::size_t wrap_index::find_line(std::size_t offset) const
+{
+	std::size_t lower = 0;
+	std::size_t upper = lines.size();
+	while(lower < upper)
+	{
+		std::size_t middle = lower + (upper - lower) / 2;
+		if(lines[middle].offset <= offset)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	return lower == 0 ? 0 : lower - 1;
+}
+
+unsigned wrap_index::get_rows(std::string const & text, std::size_t line)
+{
+	reflow_line(text, line);
+	return lines[line].rows;
+}
+
+unsigned wrap_index::get_estimated_rows(std::size_t line) const
+{
+	line_entry const & entry = lines[line];
+	if(entry.generation == generation)
+		return entry.rows;
+	return std::max((entry.columns + width - 1) / width, 1u);
+}
+
+unsigned long long wrap_index::get_row_count() const
+{
+	unsigned long long stale_rows = 0;
+	if(stale_lines_base > 0)
+		stale_rows = stale_rows_estimate * stale_lines / stale_lines_base;
+	return exact_rows + stale_rows;
+}
+
+unsigned long long wrap_index::get_rows_after(std::size_t line)
+{
+	if(line != anchor_line)
+	{
+		anchor_line = line;
+		anchor_exact_rows = 0;
+		anchor_stale_lines = 0;
+		for(std::size_t i = line + 1; i < lines.size(); i++)
+		{
+			if(lines[i].generation == generation)
+				anchor_exact_rows += lines[i].rows;
+			else
+				anchor_stale_lines++;
+		}
+	}
+	//Stale lines are estimated like in the total row count so that the rows after a line never exceed it
+	unsigned long long stale_rows = 0;
+	if(stale_lines_base > 0)
+		stale_rows = stale_rows_estimate * anchor_stale_lines / stale_lines_base;
+	return anchor_exact_rows + stale_rows;
+}
+
+void wrap_index::reflow_line(std::string const & text, std::size_t line)
+{
+	line_entry & entry = lines[line];
+	if(entry.generation == generation)
+		return;
+	entry.rows = count_line_rows(text, line);
+	entry.generation = generation;
+	exact_rows += entry.rows;
+	stale_lines--;
+	if(anchor_line != no_anchor && line > anchor_line)
+	{
+		anchor_exact_rows += entry.rows;
+		anchor_stale_lines--;
+	}
+}
+
+bool wrap_index::reflow(std::string const & text, std::size_t line_budget)
+{
+	if(stale_lines == 0)
+		reflow_cursor = 0;
+	for(; reflow_cursor > 0 && line_budget > 0; line_budget--)
+	{
+		reflow_cursor--;
+		reflow_line(text, reflow_cursor);
+	}
+	return is_complete();
+}
+
+bool wrap_index::is_complete() const
+{
+	return stale_lines == 0;
+}
+
+unsigned wrap_index::count_line_rows(std::string const & text, std::size_t line) const
+{
+	line_entry const & entry = lines[line];
+	if(entry.ascii)
+		return std::max((entry.columns + width - 1) / width, 1u);
+	return count_rows(text.c_str() + entry.offset, get_line_end(line) - entry.offset, width);
+}
+
+void wrap_index::remove_last_line()
+{
+	line_entry const & entry = lines.back();
+	if(anchor_line != no_anchor)
+	{
+		if(lines.size() - 1 <= anchor_line)
+			anchor_line = no_anchor;
+		else if(entry.generation == generation)
+			anchor_exact_rows -= entry.rows;
+		else
+			anchor_stale_lines--;
+	}
+
+	if(entry.generation == generation)
+		exact_rows -= entry.rows;
+	else
+	{
+		stale_rows_estimate -= stale_rows_estimate / stale_lines_base;
+		stale_lines_base--;
+		stale_lines--;
+	}
+	total_columns -= entry.columns;
+	end = entry.offset;
+	lines.pop_back();
+}
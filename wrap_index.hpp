@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Row breaking of a single line without newlines, rows never split characters and hold at most width columns
+unsigned count_rows(char const * data, std::size_t length, unsigned width);
+void get_row_offsets(char const * data, std::size_t length, unsigned width, std::vector<std::size_t> & offsets);
+
+//Row counts of all complete lines of the history for the current line width.
+//Changing the width only invalidates the lines, they are reflowed on demand or step by step by reflow().
+class wrap_index
+{
+public:
+	wrap_index();
+
+	void clear();
+	void truncate(std::size_t offset);
+	void append(std::string const & text, std::size_t new_end);
+	void set_width(unsigned new_width);
+	unsigned get_width() const;
+
+	//Offset following the newline of the last indexed line
+	std::size_t get_end() const;
+	std::size_t get_line_count() const;
+	std::size_t get_line_begin(std::size_t line) const;
+	std::size_t get_line_end(std::size_t line) const;
+	std::size_t find_line(std::size_t offset) const;
+
+	unsigned get_rows(std::string const & text, std::size_t line);
+	unsigned get_estimated_rows(std::size_t line) const;
+	unsigned long long get_row_count() const;
+	//Rows of the lines after the given one. The count is kept up to date for the last line asked about, so only asking about
+	//another line has to go through the lines after it.
+	unsigned long long get_rows_after(std::size_t line);
+
+	void reflow_line(std::string const & text, std::size_t line);
+	bool reflow(std::string const & text, std::size_t line_budget);
+	bool is_complete() const;
+
+private:
+	struct line_entry
+	{
+		std::size_t offset;
+		unsigned columns;
+		unsigned rows;
+		unsigned generation;
+		bool ascii;
+	};
+
+	std::vector<line_entry> lines;
+	std::size_t end;
+	unsigned width;
+	unsigned generation;
+
+	unsigned long long total_columns;
+	unsigned long long exact_rows;
+
+	//Rows of lines which have not been reflowed for the current width are extrapolated from the previous width
+	std::size_t stale_lines;
+	std::size_t stale_lines_base;
+	unsigned long long stale_rows_estimate;
+
+	std::size_t reflow_cursor;
+
+	std::size_t anchor_line;
+	unsigned long long anchor_exact_rows;
+	std::size_t anchor_stale_lines;
+
+	unsigned count_line_rows(std::string const & text, std::size_t line) const;
+	void remove_last_line();
+};